@@ -194,7 +194,7 @@ bsddialog_gauge(struct bsddialog_conf *conf, const char *text, int rows,
 			pntext++;
 		}
 		pntext[0] = '\0';
-		d.text = ntext;
+		set_dialog_text(&d, ntext);
 	}
 
 	if (input != NULL)
@@ -220,7 +220,7 @@ mvwaddcstr(WINDOW *win, int y, int x, const char *mbstring, unsigned int cols)
 	while ((charlen = mbrlen(pmbstring, MB_CUR_MAX, &mbs)) != 0 &&
 	    charlen != (size_t)-1 && charlen != (size_t)-2) {
 		mbtowc(&wch, pmbstring, charlen);
-		w += (wch == L'\t') ? TABSIZE : wcwidth(wch);
+		w += (wch == L'\t') ? TABSIZE : wchwidth(wch);
 		if (w > cols)
 			break;
 		pmbstring += charlen;
@@ -246,8 +246,8 @@ mixedgauge_size_position(struct dialog *d, int nminibars,
 
 	if (set_widget_size(d->conf, d->rows, d->cols, &d->h, &d->w) != 0)
 		return (BSDDIALOG_ERROR);
-	if (set_widget_autosize(d->conf, d->rows, d->cols, &d->h, &d->w,
-	    d->text, htext, &d->bs, nminibars + HBOX, max_minibarlen) != 0)
+	if (set_widget_autosize(d, htext, nminibars + HBOX,
+	    max_minibarlen) != 0)
 		return (BSDDIALOG_ERROR);
 	if (widget_checksize(d->h, d->w, &d->bs, nminibars + HBOX,
 	    MIN_WMGBOX) != 0)
@@ -0,0 +1,312 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021-2024 Alfonso Sabato Siciliano
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmark of the text layout, not part of the library:
+ *	make bench
+ * The static functions of lib_util.c are reached by including the source,
+ * its allocations are counted by the calloc() macro below (the arena and
+ * the layout allocate only by calloc()). The corpora are synthetic and the same for every run.
+ */
+
+#include <curses.h>
+#include <langinfo.h>
+#include <locale.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static unsigned long nallocs;
+
+static void *bench_calloc(size_t n, size_t size)
+{
+	nallocs++;
+	return (calloc(n, size));
+}
+
+#define calloc bench_calloc
+#include "lib_util.c"
+#undef calloc
+
+#define CORPUSLEN    (64 * 1024)
+#define MINNSECS     200000000LL /* every function runs at least 0.2s */
+#define PADCOLS      76
+#define VIEWROWS     20   /* visible rows of a scrolled text */
+
+enum corpus { ASCII, CJK, EMOJI, TABS, ESCAPES, NCORPUS };
+
+static const char *corpusname[NCORPUS] = {
+	"ascii", "cjk", "emoji", "tabs", "escapes"
+};
+
+static const char *words[] = {
+	"the", "dialog", "shows", "a", "message", "with", "buttons", "and",
+	"text", "wrapped", "at", "the", "width", "of", "terminal", "widget",
+	"installer", "partition", "network", "configuration"
+};
+
+#define NWORDS (sizeof(words) / sizeof(words[0]))
+
+static unsigned int seed = 1;
+
+static unsigned int rnd(unsigned int n)
+{
+	seed = seed * 1103515245 + 12345;
+	return ((seed >> 16) % n);
+}
+
+static int pututf8(char *s, unsigned int cp)
+{
+	if (cp < 0x80) {
+		s[0] = cp;
+		return (1);
+	}
+	if (cp < 0x800) {
+		s[0] = 0xC0 | (cp >> 6);
+		s[1] = 0x80 | (cp & 0x3F);
+		return (2);
+	}
+	if (cp < 0x10000) {
+		s[0] = 0xE0 | (cp >> 12);
+		s[1] = 0x80 | ((cp >> 6) & 0x3F);
+		s[2] = 0x80 | (cp & 0x3F);
+		return (3);
+	}
+	s[0] = 0xF0 | (cp >> 18);
+	s[1] = 0x80 | ((cp >> 12) & 0x3F);
+	s[2] = 0x80 | ((cp >> 6) & 0x3F);
+	s[3] = 0x80 | (cp & 0x3F);
+	return (4);
+}
+
+static char *make_corpus(enum corpus type)
+{
+	int i, j, n, nword;
+	char *s;
+	const char *w;
+
+	if ((s = malloc(CORPUSLEN + 64)) == NULL)
+		return (NULL);
+	seed = 1;
+	nword = 0;
+	i = 0;
+	while (i < CORPUSLEN) {
+		switch (type) {
+		case CJK:
+			n = 1 + rnd(8);
+			for (j = 0; j < n; j++)
+				i += pututf8(s + i, 0x4E00 + rnd(0x5000));
+			if (rnd(4) == 0)
+				s[i++] = ' ';
+			else
+				i += pututf8(s + i, 0x3002); /* full stop */
+			break;
+		case EMOJI:
+			w = words[rnd(NWORDS)];
+			memcpy(s + i, w, strlen(w));
+			i += strlen(w);
+			if (rnd(2) == 0)
+				i += pututf8(s + i, 0x1F600 + rnd(0x50));
+			s[i++] = ' ';
+			break;
+		case TABS:
+			w = words[rnd(NWORDS)];
+			memcpy(s + i, w, strlen(w));
+			i += strlen(w);
+			s[i++] = (nword % 4 == 3) ? '\n' : '\t';
+			break;
+		case ESCAPES:
+			if (rnd(3) == 0) {
+				memcpy(s + i, "\\Z", 2);
+				s[i + 2] = "bBrRuUn01234567"[rnd(15)];
+				i += 3;
+			}
+			/* FALLTHROUGH */
+		case ASCII:
+		default:
+			w = words[rnd(NWORDS)];
+			memcpy(s + i, w, strlen(w));
+			i += strlen(w);
+			s[i++] = ' ';
+			break;
+		}
+		nword++;
+		if (type != TABS && nword % 60 == 0)
+			s[i++] = '\n';
+	}
+	s[i] = '\0';
+
+	return (s);
+}
+
+static long long nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+static void
+report(const char *corpus, const char *func, long long ns, long calls,
+    unsigned long allocs, long nchars)
+{
+	printf("%-8s %-16s %10.3f %12.2f\n", corpus, func,
+	    (double)ns / calls / nchars, (double)allocs / calls);
+}
+
+/* the body runs until MINNSECS, the same way for every function */
+#define BENCH(corpus, func, nchars, body) do {				\
+	long long start_, ns_;						\
+	long calls_;							\
+									\
+	nallocs = 0;							\
+	calls_ = 0;							\
+	start_ = nsecs();						\
+	do {								\
+		body;							\
+		calls_++;						\
+	} while ((ns_ = nsecs() - start_) < MINNSECS);			\
+	report(corpus, func, ns_, calls_, nallocs, nchars);		\
+} while (0)
+
+static int bench_corpus(struct bsddialog_conf *conf, enum corpus type)
+{
+	bool multicol;
+	int rows, line, h, w, unused;
+	long nchars;
+	unsigned int cols;
+	size_t i, len, charlen;
+	char *text;
+	const char *name;
+	struct arena arena;
+	struct textproperties tp;
+	struct textlayout tl;
+	WINDOW *pad;
+
+	if ((text = make_corpus(type)) == NULL)
+		return (BSDDIALOG_ERROR);
+	name = corpusname[type];
+	conf->text.escape = (type == ESCAPES);
+
+	memset(&tl, 0, sizeof(tl));
+	tl.text = text;
+	if (compile_text(&tl, text, conf->text.escape) != 0)
+		return (BSDDIALOG_ERROR);
+	if (text_properties(conf, &tl.arena, tl.mbtext, tl.mbtextlen,
+	    &tl.tp) != 0)
+		return (BSDDIALOG_ERROR);
+	len = tl.mbtextlen;
+	nchars = 0;
+	for (i = 0; i < len; i += charlen) {
+		if ((charlen = mbnextchar(tl.mbtext + i, len - i, &unused)) == 0)
+			break;
+		nchars++;
+	}
+
+	memset(&arena, 0, sizeof(arena));
+	BENCH(name, "text_properties", nchars, {
+		text_properties(conf, &arena, tl.mbtext, tl.mbtextlen, &tp);
+		arena_free(&arena);
+	});
+
+	/* cold wrap cache, its arrays are kept */
+	text_wrap(conf, &tl, PADCOLS, &rows, &line);
+	BENCH(name, "text_autosize", nchars, {
+		memset(tl.wraprows, 0, tl.nwidths * sizeof(int));
+		text_autosize(conf, &tl, SCREENLINES - 6, 0, true, &h, &w);
+	});
+
+	if ((pad = newpad(rows, PADCOLS)) == NULL)
+		RETURN_ERROR("Cannot build the pad");
+	BENCH(name, "print_textpad", nchars,
+	    print_textpad(conf, pad, &tl, 0));
+	delwin(pad);
+
+	/* scroll to the last rows, from the checkpoints of the previous run */
+	if ((pad = newpad(MIN(rows, VIEWROWS), PADCOLS)) == NULL)
+		RETURN_ERROR("Cannot build the pad");
+	BENCH(name, "print_textend", nchars,
+	    print_textpad(conf, pad, &tl, MAX(rows - VIEWROWS, 0)));
+	delwin(pad);
+
+	BENCH(name, "strcols", nchars, strcols(tl.mbtext));
+	BENCH(name, "str_props", nchars,
+	    str_props(tl.mbtext, &cols, &multicol));
+
+	arena_free(&tl.arena);
+	free(text);
+
+	return (0);
+}
+
+int main(void)
+{
+	int i;
+	FILE *devnull;
+	SCREEN *screen;
+	struct bsddialog_conf conf;
+
+	setlocale(LC_ALL, "");
+	if (strcmp(nl_langinfo(CODESET), "UTF-8") != 0 &&
+	    setlocale(LC_ALL, "C.UTF-8") == NULL) {
+		fprintf(stderr, "bench_layout: cannot set an UTF-8 locale\n");
+		return (1);
+	}
+	utf8locale = true;
+
+	/* curses for the pads and the screen size, nothing is displayed */
+	if ((devnull = fopen("/dev/null", "r+")) == NULL) {
+		fprintf(stderr, "bench_layout: cannot open /dev/null\n");
+		return (1);
+	}
+	if ((screen = newterm("xterm", devnull, devnull)) == NULL &&
+	    (screen = newterm("vt100", devnull, devnull)) == NULL) {
+		fprintf(stderr, "bench_layout: cannot init curses\n");
+		return (1);
+	}
+	bsddialog_initconf(&conf);
+
+	printf("%-8s %-16s %10s %12s\n", "corpus", "function", "ns/char",
+	    "allocs/call");
+	for (i = 0; i < NCORPUS; i++) {
+		if (bench_corpus(&conf, i) != 0) {
+			endwin();
+			fprintf(stderr, "bench_layout: %s\n",
+			    bsddialog_geterror());
+			return (1);
+		}
+	}
+
+	endwin();
+	delscreen(screen);
+	fclose(devnull);
+
+	return (0);
+}
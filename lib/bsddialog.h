@@ -134,6 +134,13 @@ struct bsddialog_conf {
 		const char *right3_label;
 		const char *default_label;
 	} button;
+	struct {
+		bool follow;
+		unsigned int ringlines;
+		bool wrap;
+		const char *cachedir;
+		bool hex;
+	} textbox;
 };
 
 struct bsddialog_menuitem {
@@ -216,6 +223,10 @@ bsddialog_menu(struct bsddialog_conf *conf, const char *text, int rows,
     int cols, unsigned int menurows, unsigned int nitems,
     struct bsddialog_menuitem *items, int *focusitem);
 
+int
+bsddialog_menu_fd(struct bsddialog_conf *conf, const char *text, int rows,
+    int cols, unsigned int menurows, int fd, int *focusitem, char **name);
+
 int
 bsddialog_mixedgauge(struct bsddialog_conf *conf, const char *text, int rows,
     int cols, unsigned int mainperc, unsigned int nminibars,
@@ -247,6 +258,9 @@ int
 bsddialog_textbox(struct bsddialog_conf *conf, const char *file, int rows,
     int cols);
 
+int
+bsddialog_textbox_fd(struct bsddialog_conf *conf, int fd, int rows, int cols);
+
 int
 bsddialog_timebox(struct bsddialog_conf *conf, const char *text, int rows,
     int cols, unsigned int *hh, unsigned int *mm, unsigned int *ss);
@@ -89,7 +89,7 @@ struct privateform {
 };
 
 static int
-build_privateform(struct bsddialog_conf*conf, unsigned int nitems,
+build_privateform(struct dialog *d, unsigned int nitems,
     struct bsddialog_formitem *items, struct privateform *f)
 {
 	bool insecurecursor;
@@ -112,20 +112,22 @@ build_privateform(struct bsddialog_conf*conf, unsigned int nitems,
 
 	/* insecure ch */
 	insecurecursor = false;
-	if (conf->form.securembch != NULL) {
-		mbchsize = mblen(conf->form.securembch, MB_LEN_MAX);
-		if (mbtowc(&f->securewch, conf->form.securembch, mbchsize) < 0)
+	if (d->conf->form.securembch != NULL) {
+		mbchsize = mblen(d->conf->form.securembch, MB_LEN_MAX);
+		if (mbtowc(&f->securewch, d->conf->form.securembch,
+		    mbchsize) < 0)
 			RETURN_ERROR("Cannot convert securembch to wchar_t");
 		insecurecursor = true;
-	} else if (conf->form.securech != '\0') {
-		f->securewch = btowc(conf->form.securech);
+	} else if (d->conf->form.securech != '\0') {
+		f->securewch = btowc(d->conf->form.securech);
 		insecurecursor = true;
 	} else {
 		f->securewch = L' ';
 	}
 
 	/* alloc and set private items */
-	f->pritems = malloc(f->nitems * sizeof(struct privateitem));
+	f->pritems = arena_alloc(&d->arena,
+	    f->nitems * sizeof(struct privateitem));
 	if (f->pritems == NULL)
 		RETURN_ERROR("Cannot allocate internal form.pritems");
 	f->hasbottomdesc = false;
@@ -153,20 +155,20 @@ build_privateform(struct bsddialog_conf*conf, unsigned int nitems,
 			item->cursor = true;
 
 		item->maxletters = items[i].maxvaluelen;
-		item->privwbuf = calloc(item->maxletters + 1, sizeof(wchar_t));
+		item->privwbuf = arena_alloc(&d->arena,
+		    (item->maxletters + 1) * sizeof(wchar_t));
 		if (item->privwbuf == NULL)
 			RETURN_ERROR("Cannot allocate item private buffer");
-		memset(item->privwbuf, 0, item->maxletters + 1);
-		item->pubwbuf = calloc(item->maxletters + 1, sizeof(wchar_t));
+		item->pubwbuf = arena_alloc(&d->arena,
+		    (item->maxletters + 1) * sizeof(wchar_t));
 		if (item->pubwbuf == NULL)
 			RETURN_ERROR("Cannot allocate item private buffer");
-		memset(item->pubwbuf, 0, item->maxletters + 1);
 
-		if ((winit = alloc_mbstows(CHECK_STR(items[i].init))) == NULL)
+		winit = arena_mbstows(&d->arena, CHECK_STR(items[i].init));
+		if (winit == NULL)
 			RETURN_ERROR("Cannot allocate item.init in wchar_t*");
 		wcsncpy(item->privwbuf, winit, item->maxletters);
 		wcsncpy(item->pubwbuf, winit, item->maxletters);
-		free(winit);
 		item->nletters = wcslen(item->pubwbuf);
 		if (item->secure) {
 			for (j = 0; j < item->nletters; j++)
@@ -241,7 +243,7 @@ static bool fieldctl(struct privateitem *item, enum field_action act)
 		/* here some letter to left */
 		change = true;
 		item->pos -= 1;
-		width = wcwidth(item->pubwbuf[item->pos]);
+		width = wchwidth(item->pubwbuf[item->pos]);
 		if (((int)item->xcursor) - width < 0) {
 			item->xcursor = 0;
 			item->xposdraw -= 1;
@@ -253,13 +255,13 @@ static bool fieldctl(struct privateitem *item, enum field_action act)
 				break;
 			if (item->xcursor >= item->fieldcols / 2)
 				break;
-			if (wcwidth(item->pubwbuf[item->xposdraw - 1]) +
+			if (wchwidth(item->pubwbuf[item->xposdraw - 1]) +
 			    item->xcursor + width > item->fieldcols)
 				break;
 
 			item->xposdraw -= 1;
 			item->xcursor +=
-			    wcwidth(item->pubwbuf[item->xposdraw]);
+			    wchwidth(item->pubwbuf[item->xposdraw]);
 		}
 		break;
 	case DEL_LETTER:
@@ -284,25 +286,26 @@ static bool fieldctl(struct privateitem *item, enum field_action act)
 			break;
 		/* here a change to right */
 		change = true;
-		oldwidth = wcwidth(item->pubwbuf[item->pos]);
+		oldwidth = wchwidth(item->pubwbuf[item->pos]);
 		item->pos += 1;
 		if (item->pos == item->nletters) { /* empty column */
 			nextwidth = 1;
 		} else { /* a letter to right */
-			nextwidth = wcwidth(item->pubwbuf[item->pos]);
+			nextwidth = wchwidth(item->pubwbuf[item->pos]);
 		}
 		if (item->xcursor + oldwidth + nextwidth - 1 >= item->fieldcols) {
 			cols = nextwidth;
 			item->xposdraw = item->pos;
 			while (item->xposdraw != 0) {
-				cols += wcwidth(item->pubwbuf[item->xposdraw - 1]);
+				cols +=
+				    wchwidth(item->pubwbuf[item->xposdraw - 1]);
 				if (cols > (int)item->fieldcols)
 					break;
 				item->xposdraw -= 1;
 			}
 			item->xcursor = 0;
 			for (i = item->xposdraw; i < item->pos ; i++)
-				item->xcursor += wcwidth(item->pubwbuf[i]);
+				item->xcursor += wchwidth(item->pubwbuf[i]);
 		}
 		else {
 			item->xcursor += oldwidth;
@@ -481,11 +484,11 @@ drawitem(struct privateform *f, int idx, bool focus)
 	wattron(f->pad, color);
 	mvwhline(f->pad, item->yfield, item->xfield, ' ', item->fieldcols);
 	n = 0;
-	cols = wcwidth(item->pubwbuf[item->xposdraw]);
+	cols = wchwidth(item->pubwbuf[item->xposdraw]);
 	while (cols <= item->fieldcols &&
 	    item->xposdraw + n < wcslen(item->pubwbuf)) {
 		n++;
-		cols += wcwidth(item->pubwbuf[item->xposdraw + n]);
+		cols += wchwidth(item->pubwbuf[item->xposdraw + n]);
 
 	}
 	mvwaddnwstr(f->pad, item->yfield, item->xfield,
@@ -573,8 +576,7 @@ static int form_size_position(struct dialog *d, struct privateform *f)
 		hform = MAX(f->h, f->minviewrows);
 	hform += 2; /* formborders */
 
-	if (set_widget_autosize(d->conf, d->rows, d->cols, &d->h, &d->w,
-	    d->text, &htext, &d->bs, hform, f->w + 4) != 0)
+	if (set_widget_autosize(d, &htext, hform, f->w + 4) != 0)
 		return (BSDDIALOG_ERROR);
 	/* formheight: avoid overflow, "at most" and at least minviewrows */
 	if (d->h - BORDERS - htext - HBUTTONS < 2 + (int)f->minviewrows) {
@@ -676,7 +678,6 @@ bsddialog_form(struct bsddialog_conf *conf, const char *text, int rows,
 {
 	bool switchfocus, changeitem, focusinform, loop;
 	int next, retval, wchtype;
-	unsigned int i;
 	wint_t input;
 	struct privateitem *item;
 	struct privateform form;
@@ -685,15 +686,22 @@ bsddialog_form(struct bsddialog_conf *conf, const char *text, int rows,
 	if (prepare_dialog(conf, text, rows, cols, &d) != 0)
 		return (BSDDIALOG_ERROR);
 	set_buttons(&d, true, OK_LABEL, CANCEL_LABEL);
+	/* from now on an error goes to end, it frees the dialog */
+	retval = BSDDIALOG_ERROR;
+	form.box = form.pad = NULL;
 
-	if (build_privateform(conf, nitems, items, &form) != 0)
-		return (BSDDIALOG_ERROR);
+	if (build_privateform(&d, nitems, items, &form) != 0)
+		goto end;
 
-	if ((form.box = newwin(1, 1, 1, 1)) == NULL)
-		RETURN_ERROR("Cannot build WINDOW form box");
+	if ((form.box = newwin(1, 1, 1, 1)) == NULL) {
+		set_error_string("Cannot build WINDOW form box");
+		goto end;
+	}
 	wbkgd(form.box, t.dialog.color);
-	if ((form.pad = newpad(1, 1)) == NULL)
-		RETURN_ERROR("Cannot build WINDOW form pad");
+	if ((form.pad = newpad(1, 1)) == NULL) {
+		set_error_string("Cannot build WINDOW form pad");
+		goto end;
+	}
 	wbkgd(form.pad, t.dialog.color);
 
 	set_first_with_default(&form, focusitem);
@@ -708,7 +716,7 @@ bsddialog_form(struct bsddialog_conf *conf, const char *text, int rows,
 
 	form.formheight = formheight;
 	if (form_redraw(&d, &form, focusinform) != 0)
-		return (BSDDIALOG_ERROR);
+		goto end;
 
 	changeitem = switchfocus = false;
 	loop = true;
@@ -839,13 +847,17 @@ bsddialog_form(struct bsddialog_conf *conf, const char *text, int rows,
 				retval = BSDDIALOG_ERROR;
 				loop = false;
 			}
-			if (form_redraw(&d, &form, focusinform) != 0)
-				return (BSDDIALOG_ERROR);
+			if (form_redraw(&d, &form, focusinform) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		case KEY_CTRL('l'):
 		case KEY_RESIZE:
-			if (form_redraw(&d, &form, focusinform) != 0)
-				return (BSDDIALOG_ERROR);
+			if (form_redraw(&d, &form, focusinform) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		default:
 			if (wchtype == KEY_CODE_YES)
@@ -902,8 +914,10 @@ bsddialog_form(struct bsddialog_conf *conf, const char *text, int rows,
 
 	curs_set(0);
 
-	if (return_values(conf, &form, items) == BSDDIALOG_ERROR)
-		return (BSDDIALOG_ERROR);
+	if (return_values(conf, &form, items) == BSDDIALOG_ERROR) {
+		retval = BSDDIALOG_ERROR;
+		goto end;
+	}
 
 	if (focusitem != NULL)
 		*focusitem = form.sel;
@@ -912,10 +926,7 @@ bsddialog_form(struct bsddialog_conf *conf, const char *text, int rows,
 		move(SCREENLINES - 1, 2);
 		clrtoeol();
 	}
-	for (i = 0; i < form.nitems; i++) {
-		free(form.pritems[i].privwbuf);
-		free(form.pritems[i].pubwbuf);
-	}
+end:
 	delwin(form.pad);
 	delwin(form.box);
 	end_dialog(&d);
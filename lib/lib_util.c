@@ -27,6 +27,7 @@
 
 #include <stdarg.h>
 #include <curses.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -46,10 +47,15 @@
  * ----------------------------------------------------
  * -2- (Unicode) Multicolumn character strings
  *
- *	alloc_mbstows();
- *	mvwaddwch();
- *	str_props();
- *	strcols();
+ * [static] ascii_run(); (7-bit fast path).
+ * [static] mbstows_len();
+ *          alloc_mbstows();
+ *          arena_mbstows();
+ *          mbnextchar(); (UTF-8 iterator).
+ *          mvwaddwch();
+ *          strn_props();
+ *          str_props();
+ *          strcols();
  *
  * ----------------------------------------------------
  * -3- Buttons
@@ -65,8 +71,12 @@
  *
  * [static] widget_max_height(conf);
  * [static] widget_max_width(struct bsddialog_conf *conf)
- * [static] is_wtext_attr();
+ * [static] is_text_attr();
  * [static] text_properties();
+ * [static] compile_text(); (\Z escapes to runs).
+ * [static] free_textlayout();
+ * [static] get_textlayout(struct dialog); (text parsed once).
+ * [static] text_wrap(); (cached for each width).
  * [static] text_autosize();
  * [static] text_size();
  * [static] widget_min_height(conf, htext, hnotext, bool buttons);
@@ -84,17 +94,26 @@
  *	f1help_dialog(conf);
  *	draw_borders(conf, win, elev);
  *	update_box(conf, win, y, x, h, w, elev);
- *	rtextpad(); (helper for pnoutrefresh(textpad)).
  *
  * ----------------------------------------------------
  * -6- Dialog init/build, update/draw, destroy
  *
  *          end_dialog(struct dialog);
- * [static] check_set_wtext_attr();
+ *          set_dialog_text(struct dialog, text);
+ * [static] set_text_attr();
+ * [static] set_attrs();
  * [static] print_string(); (word wrapping).
- * [static] print_textpad();
+ * [static] add_checkpoints(); (printer state of the rows).
+ * [static] print_textpad(); (only the visible rows).
+ *          rtextpad(); (helper for pnoutrefresh(textpad)).
  *          draw_dialog(struct dialog);
  *          prepare_dialog(struct dialog);
+ *
+ * ----------------------------------------------------
+ * -7- Arena allocator (memory of a dialog)
+ *
+ *          arena_alloc();
+ *          arena_free();
  */
 
 /*
@@ -126,29 +145,150 @@ void set_fmt_error_string(const char *fmt, ...)
 /*
  * -2- (Unicode) Multicolumn character strings
  */
-wchar_t* alloc_mbstows(const char *mbstring)
+bool utf8locale;
+
+#define ONES64    0x0101010101010101ULL
+#define HIGHS64   0x8080808080808080ULL
+
+/*
+ * Length of the initial run of 7-bit bytes, 8 bytes at a time. If printable
+ * only bytes in [0x20, 0x7e] are counted: one column and one char each,
+ * the other bytes go to the multibyte path.
+ */
+static size_t ascii_run(const char *str, size_t len, bool printable)
+{
+	size_t i;
+	uint64_t v, bad;
+	unsigned char c;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		memcpy(&v, str + i, 8);
+		bad = v;
+		if (printable)
+			bad |= (v - 0x20 * ONES64) | (v + ONES64);
+		if ((bad & HIGHS64) != 0)
+			break;
+	}
+	for (; i < len; i++) {
+		c = (unsigned char)str[i];
+		if (c >= 0x80 || (printable && (c < 0x20 || c == 0x7f)))
+			break;
+	}
+
+	return (i);
+}
+
+/* wstring has len + 1 wchar_t set to 0, len is strlen(mbstring) */
+static void mbstows_len(wchar_t *wstring, const char *mbstring, size_t len)
 {
-	size_t charlen, nchar;
+	size_t i, n, charlen, nchar;
 	mbstate_t mbs;
-	const char *pmbstring;
-	wchar_t *wstring;
 
-	nchar = 1;
-	pmbstring = mbstring;
+	nchar = 0;
 	memset(&mbs, 0, sizeof(mbs));
-	while ((charlen = mbrlen(pmbstring, MB_CUR_MAX, &mbs)) != 0 &&
-	    charlen != (size_t)-1 && charlen != (size_t)-2) {
-		pmbstring += charlen;
+	while (len > 0) {
+		n = ascii_run(mbstring, len, false);
+		for (i = 0; i < n; i++)
+			wstring[nchar++] = (unsigned char)mbstring[i];
+		mbstring += n;
+		len -= n;
+		if (len == 0)
+			break;
+		charlen = mbrtowc(&wstring[nchar], mbstring, len, &mbs);
+		if (charlen == 0 || charlen == (size_t)-1 ||
+		    charlen == (size_t)-2) {
+			wstring[nchar] = L'\0';
+			break;
+		}
 		nchar++;
+		mbstring += charlen;
+		len -= charlen;
 	}
+}
 
-	if ((wstring = calloc(nchar, sizeof(wchar_t))) == NULL)
+wchar_t* alloc_mbstows(const char *mbstring)
+{
+	size_t len;
+	wchar_t *wstring;
+
+	/* a multibyte char has at least 1 byte, that is at most len chars */
+	len = strlen(mbstring);
+	if ((wstring = calloc(len + 1, sizeof(wchar_t))) == NULL)
 		return (NULL);
-	mbstowcs(wstring, mbstring, nchar);
+	mbstows_len(wstring, mbstring, len);
 
 	return (wstring);
 }
 
+wchar_t* arena_mbstows(struct arena *a, const char *mbstring)
+{
+	size_t len;
+	wchar_t *wstring;
+
+	len = strlen(mbstring);
+	if ((wstring = arena_alloc(a, (len + 1) * sizeof(wchar_t))) == NULL)
+		return (NULL);
+	mbstows_len(wstring, mbstring, len);
+
+	return (wstring);
+}
+
+/*
+ * Bytes of the char at mbstring, its columns in cols. Returns 0 at the end
+ * or at an invalid char. UTF-8 is decoded here, the other locales use
+ * mbrtowc().
+ */
+size_t mbnextchar(const char *mbstring, size_t len, int *cols)
+{
+	unsigned char c;
+	size_t i, charlen;
+	wchar_t wch;
+	mbstate_t mbs;
+
+	if (len == 0 || (c = (unsigned char)mbstring[0]) == '\0')
+		return (0);
+	if (c < 0x80) {
+		*cols = (c >= 0x20 && c < 0x7f) ? 1 : wchwidth(c);
+		return (1);
+	}
+
+	if (utf8locale == false) {
+		memset(&mbs, 0, sizeof(mbs));
+		charlen = mbrtowc(&wch, mbstring, len, &mbs);
+		if (charlen == 0 || charlen == (size_t)-1 ||
+		    charlen == (size_t)-2)
+			return (0);
+		*cols = wchwidth(wch);
+		return (charlen);
+	}
+
+	if (c >= 0xc2 && c <= 0xdf) {
+		charlen = 2;
+		wch = c & 0x1f;
+	} else if (c >= 0xe0 && c <= 0xef) {
+		charlen = 3;
+		wch = c & 0x0f;
+	} else if (c >= 0xf0 && c <= 0xf4) {
+		charlen = 4;
+		wch = c & 0x07;
+	} else
+		return (0);
+	if (len < charlen)
+		return (0);
+	for (i = 1; i < charlen; i++) {
+		c = (unsigned char)mbstring[i];
+		if ((c & 0xc0) != 0x80)
+			return (0);
+		wch = (wch << 6) | (c & 0x3f);
+	}
+	if ((charlen == 3 && wch < 0x800) || (wch >= 0xd800 && wch <= 0xdfff) ||
+	    (charlen == 4 && (wch < 0x10000 || wch > 0x10ffff)))
+		return (0);
+	*cols = wchwidth(wch);
+
+	return (charlen);
+}
+
 void mvwaddwch(WINDOW *w, int y, int x, wchar_t wch)
 {
 	wchar_t ws[2];
@@ -158,28 +298,41 @@ void mvwaddwch(WINDOW *w, int y, int x, wchar_t wch)
 	mvwaddwstr(w, y, x, ws);
 }
 
-int str_props(const char *mbstring, unsigned int *cols, bool *has_multi_col)
+int
+strn_props(const char *mbstring, size_t len, unsigned int *cols,
+    bool *has_multi_col)
 {
 	bool multicol;
 	int w;
 	unsigned int ncol;
-	size_t charlen, mb_cur_max;
+	size_t n, charlen, mb_cur_max;
 	wchar_t wch;
 	mbstate_t mbs;
 
 	multicol = false;
 	mb_cur_max = MB_CUR_MAX;
 	ncol = 0;
+	len = strnlen(mbstring, len);
 	memset(&mbs, 0, sizeof(mbs));
-	while ((charlen = mbrlen(mbstring, mb_cur_max, &mbs)) != 0 &&
-	    charlen != (size_t)-1 && charlen != (size_t)-2) {
-		if (mbtowc(&wch, mbstring, mb_cur_max) < 0)
+	while (len > 0) {
+		n = ascii_run(mbstring, len, true);
+		ncol += n;
+		mbstring += n;
+		len -= n;
+		if (len == 0)
+			break;
+		charlen = mbrlen(mbstring, MIN(mb_cur_max, len), &mbs);
+		if (charlen == 0 || charlen == (size_t)-1 ||
+		    charlen == (size_t)-2)
+			break;
+		if (mbtowc(&wch, mbstring, MIN(mb_cur_max, len)) < 0)
 			return (-1);
-		w = (wch == L'\t') ? TABSIZE : wcwidth(wch);
+		w = (wch == L'\t') ? TABSIZE : wchwidth(wch);
 		ncol += (w < 0) ? 0 : w;
 		if (w > 1 && wch != L'\t')
 			multicol = true;
 		mbstring += charlen;
+		len -= charlen;
 	}
 
 	if (cols != NULL)
@@ -190,25 +343,17 @@ int str_props(const char *mbstring, unsigned int *cols, bool *has_multi_col)
 	return (0);
 }
 
+int str_props(const char *mbstring, unsigned int *cols, bool *has_multi_col)
+{
+	return (strn_props(mbstring, SIZE_MAX, cols, has_multi_col));
+}
+
 unsigned int strcols(const char *mbstring)
 {
-	int w;
 	unsigned int ncol;
-	size_t charlen, mb_cur_max;
-	wchar_t wch;
-	mbstate_t mbs;
 
-	mb_cur_max = MB_CUR_MAX;
-	ncol = 0;
-	memset(&mbs, 0, sizeof(mbs));
-	while ((charlen = mbrlen(mbstring, mb_cur_max, &mbs)) != 0 &&
-	    charlen != (size_t)-1 && charlen != (size_t)-2) {
-		if (mbtowc(&wch, mbstring, mb_cur_max) < 0)
-			return (0);
-		w = (wch == L'\t') ? TABSIZE : wcwidth(wch);
-		ncol += (w < 0) ? 0 : w;
-		mbstring += charlen;
-	}
+	if (strn_props(mbstring, SIZE_MAX, &ncol, NULL) != 0)
+		return (0);
 
 	return (ncol);
 }
@@ -468,18 +613,12 @@ static int widget_max_width(struct bsddialog_conf *conf)
 	return (maxwidth);
 }
 
-static bool is_wtext_attr(const wchar_t *wtext)
+static bool is_text_attr(const char *text)
 {
-	bool att;
-
-	if (wcsnlen(wtext, 3) < 3)
-		return (false);
-	if (wtext[0] != L'\\' || wtext[1] != L'Z')
+	if (text[0] != '\\' || text[1] != 'Z' || text[2] == '\0')
 		return (false);
 
-	att = wcschr(L"nbBdDkKrRsSuU01234567", wtext[2]) == NULL ? false : true;
-
-	return (att);
+	return (strchr("nbBdDkKrRsSuU01234567", text[2]) != NULL);
 }
 
 #define NL  -1
@@ -493,49 +632,82 @@ struct textproperties {
 	int maxwordcols;
 	int maxline;
 	bool hasnewline;
+	int nnewline;
+	long long textcols; /* words, spaces and tabs */
+};
+
+/* \Z escape compiled out of the text, code applies from the byte at pos */
+struct textattr {
+	int pos;
+	char code;
+};
+
+/* printer state at the first word starting in a row, or before the row */
+struct textcheckpoint {
+	int pos;     /* byte of mbtext */
+	int y;
+	int x;
+	int attr;    /* next run to set */
+	attr_t cursesattr;
+	short pair;
+};
+
+/*
+ * The text of a dialog is parsed once, then every width is wrapped at most
+ * one time: redraws and resizes read the rows and the longest line of the
+ * previous wraps.
+ */
+struct textlayout {
+	struct arena arena; /* all the buffers of the layout */
+	const char *text;
+	char *mbtext;      /* without \Z escapes, until an invalid char */
+	int mbtextlen;
+	int nattrs;
+	struct textattr *attrs;
+	struct textproperties tp;
+	int nwidths;
+	int *wraprows; /* rows at cols, 0 if not wrapped */
+	int *wrapline; /* longest line at cols */
+	/* print_textpad() starts from the checkpoint of its first row */
+	int checkcols; /* pad cols of the checkpoints */
+	int nchecks;
+	int maxchecks;
+	struct textcheckpoint *checks; /* a checkpoint for each printed row */
 };
 
 static int
-text_properties(struct bsddialog_conf *conf, const char *text,
-    struct textproperties *tp)
+text_properties(struct bsddialog_conf *conf, struct arena *arena,
+    const char *mbtext, int mbtextlen, struct textproperties *tp)
 {
-	int i, l, currlinecols, maxwords, wtextlen, tablen, wordcols;
-	wchar_t *wtext;
+	int i, l, currlinecols, maxwords, tablen, wordcols, cols;
+	size_t charlen;
 
 	tablen = (conf->text.tablen == 0) ? TABSIZE : (int)conf->text.tablen;
 
-	maxwords = 1024;
-	if ((tp->words = calloc(maxwords, sizeof(int))) == NULL)
+	/* every separator ends at most a word and it is a word too */
+	maxwords = 1;
+	for (i = 0; i < mbtextlen; i++)
+		if (mbtext[i] == '\t' || mbtext[i] == '\n' || mbtext[i] == ' ')
+			maxwords += 2;
+	if ((tp->words = arena_alloc(arena, maxwords * sizeof(int))) == NULL)
 		RETURN_ERROR("Cannot alloc memory for text autosize");
 
-	if ((wtext = alloc_mbstows(text)) == NULL)
-		RETURN_ERROR("Cannot allocate/autosize text in wchar_t*");
-	wtextlen = wcslen(wtext);
-	if ((tp->wletters = calloc(wtextlen, sizeof(uint8_t))) == NULL)
+	tp->wletters = arena_alloc(arena, mbtextlen * sizeof(uint8_t));
+	if (tp->wletters == NULL)
 		RETURN_ERROR("Cannot allocate wletters for text autosizing");
 
 	tp->nword = 0;
 	tp->maxline = 0;
 	tp->maxwordcols = 0;
 	tp->hasnewline = false;
+	tp->nnewline = 0;
+	tp->textcols = 0;
 	currlinecols = 0;
 	wordcols = 0;
 	l = 0;
-	for (i = 0; i < wtextlen; i++) {
-		if (conf->text.escape && is_wtext_attr(wtext + i)) {
-			i += 2; /* +1 for update statement */
-			continue;
-		}
-
-		if (tp->nword + 1 >= maxwords) {
-			maxwords += 1024;
-			tp->words = realloc(tp->words, maxwords * sizeof(int));
-			if (tp->words == NULL)
-				RETURN_ERROR("Cannot realloc memory for text "
-				    "autosize");
-		}
-
-		if (wcschr(L"\t\n  ", wtext[i]) != NULL) {
+	for (i = 0; i < mbtextlen; i += charlen) {
+		charlen = 1;
+		if (strchr("\t\n ", mbtext[i]) != NULL) {
 			tp->maxwordcols = MAX(wordcols, tp->maxwordcols);
 
 			if (wordcols != 0) {
@@ -544,34 +716,40 @@ text_properties(struct bsddialog_conf *conf, const char *text,
 				/* word */
 				tp->words[tp->nword] = wordcols;
 				tp->nword += 1;
+				tp->textcols += wordcols;
 				wordcols = 0;
 			}
 
-			switch (wtext[i]) {
-			case L'\t':
+			switch (mbtext[i]) {
+			case '\t':
 				/* line */
 				currlinecols += tablen;
 				/* word */
 				tp->words[tp->nword] = TB;
+				tp->textcols += tablen;
 				break;
-			case L'\n':
+			case '\n':
 				/* line */
 				tp->hasnewline = true;
 				tp->maxline = MAX(tp->maxline, currlinecols);
 				currlinecols = 0;
 				/* word */
 				tp->words[tp->nword] = NL;
+				tp->nnewline++;
 				break;
-			case L' ':
+			case ' ':
 				/* line */
 				currlinecols += 1;
 				/* word */
 				tp->words[tp->nword] = WS;
+				tp->textcols += 1;
 				break;
 			}
 			tp->nword += 1;
 		} else {
-			tp->wletters[l] = wcwidth(wtext[i]);
+			/* mbtext has only valid chars */
+			charlen = mbnextchar(mbtext + i, mbtextlen - i, &cols);
+			tp->wletters[l] = cols;
 			wordcols += tp->wletters[l];
 			l++;
 		}
@@ -580,91 +758,225 @@ text_properties(struct bsddialog_conf *conf, const char *text,
 	if (wordcols != 0) {
 		tp->words[tp->nword] = wordcols;
 		tp->nword += 1;
+		tp->textcols += wordcols;
 		tp->maxwordcols = MAX(wordcols, tp->maxwordcols);
 	}
 	/* line */
 	tp->maxline = MAX(tp->maxline, currlinecols);
 
-	free(wtext);
+	return (0);
+}
+
+/*
+ * Copy of the text without the \Z escapes, the sizer and the printer get
+ * the attribute runs. It ends at the first invalid char.
+ */
+static int compile_text(struct textlayout *tl, const char *text, bool escape)
+{
+	int i, j, len, maxattrs, unused;
+	size_t charlen;
+
+	len = strlen(text);
+	if ((tl->mbtext = arena_alloc(&tl->arena, len + 1)) == NULL)
+		RETURN_ERROR("Cannot allocate text layout");
+
+	maxattrs = 0;
+	if (escape) {
+		for (i = 0; i < len; i++)
+			if (text[i] == '\\')
+				maxattrs++;
+	}
+	tl->attrs = arena_alloc(&tl->arena, maxattrs * sizeof(struct textattr));
+	if (tl->attrs == NULL)
+		RETURN_ERROR("Cannot allocate text attributes");
+
+	for (i = 0, j = 0; i < len; ) {
+		if (escape && is_text_attr(text + i)) {
+			tl->attrs[tl->nattrs].pos = j;
+			tl->attrs[tl->nattrs].code = text[i + 2];
+			tl->nattrs++;
+			i += 3;
+			continue;
+		}
+		if ((charlen = mbnextchar(text + i, len - i, &unused)) == 0)
+			break;
+		memcpy(tl->mbtext + j, text + i, charlen);
+		i += charlen;
+		j += charlen;
+	}
+	tl->mbtext[j] = '\0';
+	tl->mbtextlen = j;
 
 	return (0);
 }
 
-static int
-text_autosize(struct bsddialog_conf *conf, struct textproperties *tp,
-    int maxrows, int mincols, bool increasecols, int *h, int *w)
+static void free_textlayout(struct textlayout *tl)
 {
-	int i, j, x, y, z, l, line, maxwidth, tablen;
+	if (tl == NULL)
+		return;
 
-	maxwidth = widget_max_width(conf) - BORDERS - TEXTHMARGINS;
-	tablen = (conf->text.tablen == 0) ? TABSIZE : (int)conf->text.tablen;
+	arena_free(&tl->arena);
+	free(tl);
+}
 
-	if (increasecols) {
-		mincols = MAX(mincols, tp->maxwordcols);
-		mincols = MAX(mincols,
-		    (int)conf->auto_minwidth - BORDERS - TEXTHMARGINS);
-		mincols = MIN(mincols, maxwidth);
+static struct textlayout *get_textlayout(struct dialog *d)
+{
+	struct textlayout *tl;
+
+	if (d->layout != NULL && d->layout->text == d->text)
+		return (d->layout);
+	free_textlayout(d->layout);
+
+	if ((d->layout = tl = calloc(1, sizeof(struct textlayout))) == NULL) {
+		set_error_string("Cannot alloc memory for text layout");
+		return (NULL);
 	}
+	tl->text = d->text;
+	if (compile_text(tl, d->text, d->conf->text.escape) != 0)
+		return (NULL);
+	if (text_properties(d->conf, &tl->arena, tl->mbtext, tl->mbtextlen,
+	    &tl->tp) != 0)
+		return (NULL);
 
-	while (true) {
-		x = 0;
-		y = 1;
-		line=0;
-		l = 0;
-		for (i = 0; i < tp->nword; i++) {
-			switch (tp->words[i]) {
-			case TB:
-				for (j = 0; j < tablen; j++) {
-					if (x >= mincols) {
-						x = 0;
-						y++;
-					}
-				x++;
-				}
-				break;
-			case NL:
-				y++;
-				x = 0;
-				break;
-			case WS:
-				x++;
-				if (x >= mincols) {
+	return (tl);
+}
+
+/* rows and cols of the longest line of the text wrapped at cols */
+static int
+text_wrap(struct bsddialog_conf *conf, struct textlayout *tl, int cols,
+    int *rows, int *linecols)
+{
+	int i, j, x, y, z, l, line, tablen, nwidths, *wraprows, *wrapline;
+	struct textproperties *tp;
+
+	/* empty text with fixed cols, text_size() checks the other texts */
+	if (cols <= 0) {
+		*rows = 1;
+		*linecols = 0;
+		return (0);
+	}
+	if (cols < tl->nwidths && tl->wraprows[cols] != 0) {
+		*rows = tl->wraprows[cols];
+		*linecols = tl->wrapline[cols];
+		return (0);
+	}
+	if (cols >= tl->nwidths) {
+		nwidths = MAX(cols + 1, tl->nwidths * 2);
+		wraprows = arena_alloc(&tl->arena, nwidths * sizeof(int));
+		wrapline = arena_alloc(&tl->arena, nwidths * sizeof(int));
+		if (wraprows == NULL || wrapline == NULL)
+			RETURN_ERROR("Cannot allocate memory for text wrap");
+		if (tl->nwidths > 0) {
+			memcpy(wraprows, tl->wraprows, tl->nwidths * sizeof(int));
+			memcpy(wrapline, tl->wrapline, tl->nwidths * sizeof(int));
+		}
+		tl->wraprows = wraprows;
+		tl->wrapline = wrapline;
+		tl->nwidths = nwidths;
+	}
+
+	tp = &tl->tp;
+	tablen = (conf->text.tablen == 0) ? TABSIZE : (int)conf->text.tablen;
+
+	x = 0;
+	y = 1;
+	line = 0;
+	l = 0;
+	for (i = 0; i < tp->nword; i++) {
+		switch (tp->words[i]) {
+		case TB:
+			for (j = 0; j < tablen; j++) {
+				if (x >= cols) {
 					x = 0;
 					y++;
 				}
-				break;
-			default:
-				if (tp->words[i] + x <= mincols) {
-					x += tp->words[i];
-					for (z = 0 ; z != tp->words[i]; l++ )
-						z += tp->wletters[l];
-				} else if (tp->words[i] <= mincols) {
-					y++;
-					x = tp->words[i];
-					for (z = 0 ; z != tp->words[i]; l++ )
+				x++;
+			}
+			break;
+		case NL:
+			y++;
+			x = 0;
+			break;
+		case WS:
+			x++;
+			if (x >= cols) {
+				x = 0;
+				y++;
+			}
+			break;
+		default:
+			if (tp->words[i] + x <= cols) {
+				x += tp->words[i];
+				for (z = 0 ; z != tp->words[i]; l++ )
+					z += tp->wletters[l];
+			} else if (tp->words[i] <= cols) {
+				y++;
+				x = tp->words[i];
+				for (z = 0 ; z != tp->words[i]; l++ )
+					z += tp->wletters[l];
+			} else {
+				for (j = tp->words[i]; j > 0; ) {
+					y = (x == 0) ? y : y + 1;
+					z = 0;
+					while (z != j && z < cols) {
 						z += tp->wletters[l];
-				} else {
-					for (j = tp->words[i]; j > 0; ) {
-						y = (x == 0) ? y : y + 1;
-						z = 0;
-						while (z != j && z < mincols) {
-							z += tp->wletters[l];
-							l++;
-						}
-						x = z;
-						line = MAX(line, x);
-						j -= z;
+						l++;
 					}
+					x = z;
+					line = MAX(line, x);
+					j -= z;
 				}
 			}
-			line = MAX(line, x);
 		}
+		line = MAX(line, x);
+	}
 
+	tl->wraprows[cols] = *rows = y;
+	tl->wrapline[cols] = *linecols = line;
+
+	return (0);
+}
+
+/*
+ * Every row has at most cols + 1 columns, a 2-column char can split a word
+ * longer than cols at the edge, and the longest line is not wider, so a
+ * width with the cols_per_row ratio has:
+ *   cols + 1 >= ratio * rows >=
+ *       ratio * MAX(newlines + 1, columns of text / (cols + 1))
+ * the widths before this bound are skipped without wrapping the text, the
+ * next widths are wrapped until the ratio is found like before.
+ */
+static int
+text_autosize(struct bsddialog_conf *conf, struct textlayout *tl,
+    int maxrows, int mincols, bool increasecols, int *h, int *w)
+{
+	int y, line, maxwidth, ratio;
+	struct textproperties *tp;
+
+	tp = &tl->tp;
+	maxwidth = widget_max_width(conf) - BORDERS - TEXTHMARGINS;
+	ratio = conf->text.cols_per_row;
+
+	if (increasecols) {
+		mincols = MAX(mincols, tp->maxwordcols);
+		mincols = MAX(mincols,
+		    (int)conf->auto_minwidth - BORDERS - TEXTHMARGINS);
+		mincols = MIN(mincols, maxwidth);
+		mincols = MAX(mincols,
+		    MIN((long long)ratio * (tp->nnewline + 1) - 1, maxwidth));
+		while (mincols < maxwidth && (long long)mincols + 1 <
+		    ratio * ((tp->textcols + mincols) / MAX(mincols + 1, 1)))
+			mincols++;
+	}
+
+	while (true) {
+		if (text_wrap(conf, tl, mincols, &y, &line) != 0)
+			return (BSDDIALOG_ERROR);
 		if (increasecols == false)
 			break;
 		if (mincols >= maxwidth)
 			break;
-		if (line >= y * (int)conf->text.cols_per_row && y <= maxrows)
+		if (line >= y * ratio && y <= maxrows)
 			break;
 		mincols++;
 	}
@@ -676,37 +988,38 @@ text_autosize(struct bsddialog_conf *conf, struct textproperties *tp,
 }
 
 static int
-text_size(struct bsddialog_conf *conf, int rows, int cols, const char *text,
-    struct buttons *bs, int rowsnotext, int startwtext, int *htext, int *wtext)
+text_size(struct dialog *d, int rowsnotext, int startwtext, int *htext,
+    int *wtext)
 {
 	bool changewtext;
 	int wbuttons, maxhtext;
-	struct textproperties tp;
+	struct textlayout *tl;
 
 	wbuttons = 0;
-	if (bs->nbuttons > 0)
-		wbuttons = buttons_min_width(bs);
+	if (d->bs.nbuttons > 0)
+		wbuttons = buttons_min_width(&d->bs);
 
 	/* Rows */
-	if (rows == BSDDIALOG_AUTOSIZE || rows == BSDDIALOG_FULLSCREEN) {
-		maxhtext = widget_max_height(conf) - BORDERS - rowsnotext;
+	if (d->rows == BSDDIALOG_AUTOSIZE || d->rows == BSDDIALOG_FULLSCREEN) {
+		maxhtext = widget_max_height(d->conf) - BORDERS - rowsnotext;
 	} else { /* fixed */
-		maxhtext = rows - BORDERS - rowsnotext;
+		maxhtext = d->rows - BORDERS - rowsnotext;
 	}
-	if (bs->nbuttons > 0)
+	if (d->bs.nbuttons > 0)
 		maxhtext -= 2;
 	if (maxhtext <= 0)
 		maxhtext = 1; /* text_autosize() computes always htext */
 
 	/* Cols */
-	if (cols == BSDDIALOG_AUTOSIZE) {
+	if (d->cols == BSDDIALOG_AUTOSIZE) {
 		startwtext = MAX(startwtext, wbuttons - TEXTHMARGINS);
 		changewtext = true;
-	} else if (cols == BSDDIALOG_FULLSCREEN) {
-		startwtext = widget_max_width(conf) - BORDERS - TEXTHMARGINS;
+	} else if (d->cols == BSDDIALOG_FULLSCREEN) {
+		startwtext = widget_max_width(d->conf) - BORDERS -
+		    TEXTHMARGINS;
 		changewtext = false;
 	} else { /* fixed */
-		startwtext = cols - BORDERS - TEXTHMARGINS;
+		startwtext = d->cols - BORDERS - TEXTHMARGINS;
 		changewtext = false;
 	}
 
@@ -714,19 +1027,16 @@ text_size(struct bsddialog_conf *conf, int rows, int cols, const char *text,
 		startwtext = 1;
 
 	/* Sizing calculation */
-	if (text_properties(conf, text, &tp) != 0)
+	if ((tl = get_textlayout(d)) == NULL)
 		return (BSDDIALOG_ERROR);
-	if (tp.nword > 0 && startwtext <= 0)
+	if (tl->tp.nword > 0 && startwtext <= 0)
 		RETURN_FMTERROR("(fixed cols or fullscreen) "
 		    "needed at least %d cols to draw text",
 		    BORDERS + TEXTHMARGINS + 1);
-	if (text_autosize(conf, &tp, maxhtext, startwtext, changewtext, htext,
-	    wtext) != 0)
+	if (text_autosize(d->conf, tl, maxhtext, startwtext, changewtext,
+	    htext, wtext) != 0)
 		return (BSDDIALOG_ERROR);
 
-	free(tp.words);
-	free(tp.wletters);
-
 	return (0);
 }
 
@@ -827,29 +1137,27 @@ set_widget_size(struct bsddialog_conf *conf, int rows, int cols, int *h, int *w)
 }
 
 int
-set_widget_autosize(struct bsddialog_conf *conf, int rows, int cols, int *h,
-    int *w, const char *text, int *rowstext, struct buttons *bs, int hnotext,
-    int minw)
+set_widget_autosize(struct dialog *d, int *rowstext, int hnotext, int minw)
 {
 	int htext, wtext;
 
-	if (rows == BSDDIALOG_AUTOSIZE || cols == BSDDIALOG_AUTOSIZE ||
+	if (d->rows == BSDDIALOG_AUTOSIZE || d->cols == BSDDIALOG_AUTOSIZE ||
 	    rowstext != NULL) {
-		if (text_size(conf, rows, cols, text, bs, hnotext, minw,
-		    &htext, &wtext) != 0)
+		if (text_size(d, hnotext, minw, &htext, &wtext) != 0)
 			return (BSDDIALOG_ERROR);
 		if (rowstext != NULL)
 			*rowstext = htext;
 	}
 
-	if (rows == BSDDIALOG_AUTOSIZE) {
-		*h = widget_min_height(conf, htext, hnotext, bs->nbuttons > 0);
-		*h = MIN(*h, widget_max_height(conf));
+	if (d->rows == BSDDIALOG_AUTOSIZE) {
+		d->h = widget_min_height(d->conf, htext, hnotext,
+		    d->bs.nbuttons > 0);
+		d->h = MIN(d->h, widget_max_height(d->conf));
 	}
 
-	if (cols == BSDDIALOG_AUTOSIZE) {
-		*w = widget_min_width(conf, wtext, minw, bs);
-		*w = MIN(*w, widget_max_width(conf));
+	if (d->cols == BSDDIALOG_AUTOSIZE) {
+		d->w = widget_min_width(d->conf, wtext, minw, &d->bs);
+		d->w = MIN(d->w, widget_max_width(d->conf));
 	}
 
 	return (0);
@@ -923,8 +1231,7 @@ int dialog_size_position(struct dialog *d, int hnotext, int minw, int *htext)
 {
 	if (set_widget_size(d->conf, d->rows, d->cols, &d->h, &d->w) != 0)
 		return (BSDDIALOG_ERROR);
-	if (set_widget_autosize(d->conf, d->rows, d->cols, &d->h, &d->w,
-	    d->text, htext, &d->bs, hnotext, minw) != 0)
+	if (set_widget_autosize(d, htext, hnotext, minw) != 0)
 		return (BSDDIALOG_ERROR);
 	if (widget_checksize(d->h, d->w, &d->bs, hnotext, minw) != 0)
 		return (BSDDIALOG_ERROR);
@@ -1034,29 +1341,26 @@ update_box(struct bsddialog_conf *conf, WINDOW *win, int y, int x, int h, int w,
 	draw_borders(conf, win, elev);
 }
 
-void
-rtextpad(struct dialog *d, int ytext, int xtext, int upnotext, int downnotext)
-{
-	pnoutrefresh(d->textpad, ytext, xtext,
-	    d->y + BORDER + upnotext,
-	    d->x + BORDER + TEXTHMARGIN,
-	    d->y + d->h - 1 - downnotext - BORDER,
-	    d->x + d->w - TEXTHMARGIN - BORDER);
-}
-
 /*
  * -6- Dialog init/build, update/draw, destroy
  */
 void end_dialog(struct dialog *d)
 {
-	if (d->conf->sleep > 0)
+	/* an error before draw_dialog(), the dialog has no position or size */
+	if (d->built && d->conf->sleep > 0)
 		sleep(d->conf->sleep);
 
+	free_textlayout(d->layout);
+	d->layout = NULL;
+	arena_free(&d->arena);
 	delwin(d->textpad);
 	delwin(d->widget);
 	if (d->conf->shadow)
 		delwin(d->shadow);
 
+	if (d->built == false)
+		return;
+
 	if (d->conf->clear)
 		hide_dialog(d);
 
@@ -1066,195 +1370,264 @@ void end_dialog(struct dialog *d)
 		*d->conf->get_width = d->w;
 }
 
-static bool check_set_wtext_attr(WINDOW *win, wchar_t *wtext)
+/* the text can change in the same buffer, the layout is parsed again */
+void set_dialog_text(struct dialog *d, const char *text)
 {
-	enum bsddialog_color bg;
+	free_textlayout(d->layout);
+	d->layout = NULL;
+	d->text = CHECK_STR(text);
+}
 
-	if (is_wtext_attr(wtext) == false)
-		return (false);
+static void set_text_attr(WINDOW *win, char code)
+{
+	enum bsddialog_color bg;
 
-	if ((wtext[2] >= L'0') && (wtext[2] <= L'7')) {
+	if ((code >= '0') && (code <= '7')) {
 		bsddialog_color_attrs(t.dialog.color, NULL, &bg, NULL);
-		wattron(win, bsddialog_color(wtext[2] - L'0', bg, 0));
-		return (true);
+		wattron(win, bsddialog_color(code - '0', bg, 0));
+		return;
 	}
 
-	switch (wtext[2]) {
-	case L'n':
+	switch (code) {
+	case 'n':
 		wattron(win, t.dialog.color);
 		wattrset(win, A_NORMAL);
 		break;
-	case L'b':
+	case 'b':
 		wattron(win, A_BOLD);
 		break;
-	case L'B':
+	case 'B':
 		wattroff(win, A_BOLD);
 		break;
-	case L'd':
+	case 'd':
 		wattron(win, A_DIM);
 		break;
-	case L'D':
+	case 'D':
 		wattroff(win, A_DIM);
 		break;
-	case L'k':
+	case 'k':
 		wattron(win, A_BLINK);
 		break;
-	case L'K':
+	case 'K':
 		wattroff(win, A_BLINK);
 		break;
-	case L'r':
+	case 'r':
 		wattron(win, A_REVERSE);
 		break;
-	case L'R':
+	case 'R':
 		wattroff(win, A_REVERSE);
 		break;
-	case L's':
+	case 's':
 		wattron(win, A_STANDOUT);
 		break;
-	case L'S':
+	case 'S':
 		wattroff(win, A_STANDOUT);
 		break;
-	case L'u':
+	case 'u':
 		wattron(win, A_UNDERLINE);
 		break;
-	case L'U':
+	case 'U':
 		wattroff(win, A_UNDERLINE);
 		break;
 	}
-
-	return (true);
 }
 
+/* set the attributes of the runs starting at or before pos */
 static void
-print_string(WINDOW *win, int *rows, int cols, int *y, int *x, wchar_t *str,
-    bool color)
+set_attrs(WINDOW *win, struct textlayout *tl, int *attr, int pos)
 {
-	int charwidth, i, j, strlen, strwidth;
-	wchar_t ws[2];
+	while (*attr < tl->nattrs && tl->attrs[*attr].pos <= pos) {
+		set_text_attr(win, tl->attrs[*attr].code);
+		(*attr)++;
+	}
+}
 
-	ws[1] = L'\0';
+/* textpad holds only the rows [ystart, yend) of the wrapped text */
+struct textcursor {
+	WINDOW *pad;
+	int cols;
+	int ystart;
+	int yend;
+	int y;
+	int x;
+	int attr; /* next run to set */
+};
 
-	strlen = wcslen(str);
-	if (color) {
-		strwidth = 0;
-		i=0;
-		while (i < strlen) {
-			if (is_wtext_attr(str+i) == false) {
-				strwidth += wcwidth(str[i]);
-				i++;
-			} else {
-				i += 3;
-			}
-		}
-	} else
-		strwidth = wcswidth(str, strlen);
-
-	i = 0;
-	while (i < strlen) {
-		if (*x + strwidth > cols) {
-			if (*x != 0)
-				*y = *y + 1;
-			if (*y >= *rows) {
-				*rows = *y + 1;
-				wresize(win, *rows, cols);
-			}
-			*x = 0;
+/* output the chars of a run with one curses call, if in the pad */
+#define PRINT_RUN(c, str, n, xrun) do {                                        \
+	if ((n) > 0 && (c)->y >= (c)->ystart && (c)->y < (c)->yend)            \
+		mvwaddnstr((c)->pad, (c)->y - (c)->ystart, xrun, str, n);      \
+} while (0)
+
+/* word wrapping of mbtext[start, end), curses converts only printed runs */
+static void
+print_string(struct textcursor *c, struct textlayout *tl, int start, int end)
+{
+	int charwidth, i, j, run, xrun, strwidth;
+	size_t charlen;
+	char *str;
+
+	str = tl->mbtext;
+	strwidth = 0;
+	for (i = start; i < end; i += charlen) {
+		charlen = mbnextchar(str + i, end - i, &charwidth);
+		strwidth += charwidth;
+	}
+
+	i = start;
+	while (i < end) {
+		if (c->x + strwidth > c->cols) {
+			if (c->x != 0)
+				c->y++;
+			c->x = 0;
 		}
-		j = *x;
-		while (i < strlen) {
-			if (color && check_set_wtext_attr(win, str+i)) {
-				i += 3;
-				continue;
+		j = c->x;
+		run = i;
+		xrun = j;
+		while (i < end) {
+			if (c->attr < tl->nattrs && tl->attrs[c->attr].pos <= i) {
+				PRINT_RUN(c, str + run, i - run, xrun);
+				set_attrs(c->pad, tl, &c->attr, i);
+				run = i;
+				xrun = j;
 			}
 
-			charwidth = wcwidth(str[i]);
-			if (j + wcwidth(str[i]) > cols)
+			charlen = mbnextchar(str + i, end - i, &charwidth);
+			if (j + charwidth > c->cols)
 				break;
-			/* inline mvwaddwch() for efficiency */
-			ws[0] = str[i];
-			mvwaddwstr(win, *y, j, ws);
 			strwidth -= charwidth;
 			j += charwidth;
-			*x = j;
-			i++;
+			c->x = j;
+			i += charlen;
 		}
+		PRINT_RUN(c, str + run, i - run, xrun);
 	}
+	set_attrs(c->pad, tl, &c->attr, end);
 }
 
-static int
-print_textpad(struct bsddialog_conf *conf, WINDOW *pad, const char *text)
+/*
+ * Every word starts at a checkpoint, the rows after the row of a word get it
+ * until the next word: printing from the checkpoint of a row reproduces the
+ * row, the text before it in the previous row is out of the pad.
+ */
+static void
+add_checkpoints(struct textlayout *tl, struct textcheckpoint *prev,
+    struct textcursor *c, int pos)
 {
-	bool loop;
-	int i, j, z, rows, cols, x, y, tablen;
-	wchar_t *wtext, *string;
-
-	if ((wtext = alloc_mbstows(text)) == NULL)
-		RETURN_ERROR("Cannot allocate/print text in wchar_t*");
+	int maxchecks;
+	struct textcheckpoint *checks;
+
+	if (c->y >= tl->maxchecks) {
+		maxchecks = MAX(c->y + 1, tl->maxchecks * 2);
+		checks = arena_alloc(&tl->arena,
+		    maxchecks * sizeof(struct textcheckpoint));
+		if (checks == NULL)
+			return; /* printed from the last checkpoint */
+		if (tl->nchecks > 0)
+			memcpy(checks, tl->checks,
+			    tl->nchecks * sizeof(struct textcheckpoint));
+		tl->checks = checks;
+		tl->maxchecks = maxchecks;
+	}
+	for (; tl->nchecks <= c->y; tl->nchecks++)
+		tl->checks[tl->nchecks] = *prev;
+
+	prev->pos = pos;
+	prev->y = c->y;
+	prev->x = c->x;
+	prev->attr = c->attr;
+	wattr_get(c->pad, &prev->cursesattr, &prev->pair, NULL);
+}
 
-	if ((string = calloc(wcslen(wtext) + 1, sizeof(wchar_t))) == NULL)
-		RETURN_ERROR("Cannot build (analyze) text");
+/*
+ * The text is wrapped from the checkpoint of ystart, or from the last one,
+ * and it stops after the last pad row: a scroll prints the visible rows.
+ */
+static void
+print_textpad(struct bsddialog_conf *conf, WINDOW *pad, struct textlayout *tl,
+    int ystart)
+{
+	int i, start, z, tablen;
+	char *mbtext;
+	struct textcheckpoint ck;
+	struct textcursor c;
 
-	getmaxyx(pad, rows, cols);
+	mbtext = tl->mbtext;
 	tablen = (conf->text.tablen == 0) ? TABSIZE : (int)conf->text.tablen;
 
-	i = j = x = y = 0;
-	loop = true;
-	while (loop) {
-		string[j] = wtext[i];
-
-		if (wcschr(L"\n\t  ", string[j]) != NULL || string[j] == L'\0') {
-			string[j] = L'\0';
-			print_string(pad, &rows, cols, &y, &x, string,
-			    conf->text.escape);
-		}
-
-		switch (wtext[i]) {
-		case L'\0':
-			loop = false;
-			break;
-		case L'\n':
-			x = 0;
-			y++;
-			j = -1;
+	werase(pad);
+	wattrset(pad, A_NORMAL);
+	c.pad = pad;
+	c.cols = getmaxx(pad);
+	c.ystart = ystart;
+	c.yend = ystart + getmaxy(pad);
+	if (tl->checkcols != c.cols) {
+		tl->checkcols = c.cols;
+		tl->nchecks = 0;
+	}
+	memset(&ck, 0, sizeof(ck));
+	wattr_get(pad, &ck.cursesattr, &ck.pair, NULL);
+	if (tl->nchecks > 0) {
+		ck = tl->checks[MIN(ystart, tl->nchecks - 1)];
+		wattr_set(pad, ck.cursesattr, ck.pair, NULL);
+	}
+	c.x = ck.x;
+	c.y = ck.y;
+	c.attr = ck.attr;
+	start = ck.pos;
+	/* 1 byte separators, not in a multibyte char; strchr() finds the NUL */
+	for (i = start; i <= tl->mbtextlen && c.y < c.yend; i++) {
+		if (strchr("\n\t ", mbtext[i]) == NULL)
+			continue;
+		add_checkpoints(tl, &ck, &c, start);
+		print_string(&c, tl, start, i);
+		start = i + 1;
+
+		switch (mbtext[i]) {
+		case '\n':
+			c.x = 0;
+			c.y++;
 			break;
-		case L'\t':
+		case '\t':
 			for (z = 0; z < tablen; z++) {
-				if (x >= cols) {
-					x = 0;
-					y++;
+				if (c.x >= c.cols) {
+					c.x = 0;
+					c.y++;
 				}
-				x++;
+				c.x++;
 			}
-			j = -1;
 			break;
-		case L' ':
-			x++;
-			if (x >= cols) {
-				x = 0;
-				y++;
+		case ' ':
+			c.x++;
+			if (c.x >= c.cols) {
+				c.x = 0;
+				c.y++;
 			}
-			j = -1;
 		}
-
-		if (y >= rows) {
-			rows = y + 1;
-			wresize(pad, rows, cols);
-		}
-
-		j++;
-		i++;
 	}
+}
 
-	free(wtext);
-	free(string);
+/* text rows out of the pad are printed again before the refresh */
+void
+rtextpad(struct dialog *d, int ytext, int xtext, int upnotext, int downnotext)
+{
+	if (ytext != d->ytextpad && d->layout != NULL) {
+		print_textpad(d->conf, d->textpad, d->layout, ytext);
+		d->ytextpad = ytext;
+	}
 
-	return (0);
+	pnoutrefresh(d->textpad, 0, xtext,
+	    d->y + BORDER + upnotext,
+	    d->x + BORDER + TEXTHMARGIN,
+	    d->y + d->h - 1 - downnotext - BORDER,
+	    d->x + d->w - TEXTHMARGIN - BORDER);
 }
 
 int draw_dialog(struct dialog *d)
 {
-	int wtitle, wbottomtitle;
+	int wtitle, wbottomtitle, htext, wtext, unused;
 	cchar_t ts, ltee, rtee;
+	struct textlayout *tl;
 
 	if (d->conf->ascii_lines) {
 		setcchar(&ts, L"-", 0, 0, NULL);
@@ -1324,11 +1697,18 @@ int draw_dialog(struct dialog *d)
 	wnoutrefresh(d->widget);
 
 	wclear(d->textpad);
+	if ((tl = get_textlayout(d)) == NULL)
+		return (BSDDIALOG_ERROR);
 	/* `infobox "" 0 2` fails but text is empty and textpad remains 1 1 */
-	wresize(d->textpad, 1, d->w - BORDERS - TEXTHMARGINS);
-
-	if (print_textpad(d->conf, d->textpad, d->text) != 0)
+	wtext = d->w - BORDERS - TEXTHMARGINS;
+	htext = 1;
+	/* the rows of the autosize, the pad has only the visible ones */
+	if (wtext > 0 && text_wrap(d->conf, tl, wtext, &htext, &unused) != 0)
 		return (BSDDIALOG_ERROR);
+	d->textrows = htext;
+	wresize(d->textpad, MIN(htext, MAX(d->h - BORDERS, 1)), wtext);
+	print_textpad(d->conf, d->textpad, tl, 0);
+	d->ytextpad = 0;
 
 	d->built = true;
 
@@ -1346,6 +1726,10 @@ prepare_dialog(struct bsddialog_conf *conf, const char *text, int rows,
 	d->rows = rows;
 	d->cols = cols;
 	d->text = CHECK_STR(text);
+	d->layout = NULL;
+	d->arena.head = NULL;
+	d->textrows = 0;
+	d->ytextpad = 0;
 	d->bs.nbuttons = 0;
 
 	if (d->conf->shadow) {
@@ -1364,4 +1748,57 @@ prepare_dialog(struct bsddialog_conf *conf, const char *text, int rows,
 	wbkgd(d->textpad, t.dialog.color);
 
 	return (0);
-}
\ No newline at end of file
+}
+
+/*
+ * -7- Arena allocator
+ */
+#define ARENABLOCK  (16 * 1024)
+#define ARENAALIGN  16
+#define ARENAHEADER ((sizeof(struct arenablock) + ARENAALIGN - 1) &           \
+    ~(size_t)(ARENAALIGN - 1))
+
+struct arenablock {
+	struct arenablock *next;
+	size_t size;
+	size_t used;
+};
+
+/* zeroed memory, freed only by arena_free() */
+void *arena_alloc(struct arena *a, size_t size)
+{
+	struct arenablock *block;
+	void *p;
+
+	size = (size + ARENAALIGN - 1) & ~(size_t)(ARENAALIGN - 1);
+	block = a->head;
+	if (block == NULL || block->size - block->used < size) {
+		block = calloc(1, ARENAHEADER + MAX(size, ARENABLOCK));
+		if (block == NULL)
+			return (NULL);
+		block->size = MAX(size, ARENABLOCK);
+		/* a big buffer does not hide the space left in the head */
+		if (size > ARENABLOCK / 4 && a->head != NULL) {
+			block->next = a->head->next;
+			a->head->next = block;
+		} else {
+			block->next = a->head;
+			a->head = block;
+		}
+	}
+	p = (char *)block + ARENAHEADER + block->used;
+	block->used += size;
+
+	return (p);
+}
+
+void arena_free(struct arena *a)
+{
+	struct arenablock *block;
+
+	while (a->head != NULL) {
+		block = a->head;
+		a->head = block->next;
+		free(block);
+	}
+}
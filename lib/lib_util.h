@@ -95,6 +95,13 @@ struct buttons {
 	unsigned int sizebutton; /* including left and right delimiters */
 };
 
+struct textlayout; /* parsed text, private to lib_util.c */
+
+struct arenablock;
+struct arena {
+	struct arenablock *head;
+};
+
 struct dialog {
 	bool built;         /* true after the first draw_dialog() */
 	struct bsddialog_conf *conf;  /* Checked API conf */
@@ -103,7 +110,11 @@ struct dialog {
 	int rows, cols;     /* API rows and cols: -1, 0, >0 */
 	int h, w;           /* Current height and width */
 	const char *text;   /* Checked API text, at least "" */
+	struct textlayout *layout; /* text cache, set_dialog_text() resets it */
+	struct arena arena; /* buffers of the dialog, end_dialog() frees it */
 	WINDOW *textpad;    /* Fake for textbox */
+	int textrows;       /* rows of the wrapped text, draw_dialog() */
+	int ytextpad;       /* first text row printed in textpad */
 	struct buttons bs;  /* bs.nbuttons = 0 for no buttons */
 	WINDOW *shadow;
 };
@@ -114,10 +125,35 @@ void set_error_string(const char *string);
 void set_fmt_error_string(const char *fmt, ...);
 
 /* multicolumn character string */
+extern bool utf8locale;
+extern const unsigned char wcwidth_index[];
+extern const unsigned char wcwidth_blocks[][64];
+
+/* wcwidth() from the builtin Unicode table (wcwidth.c) in UTF-8 locales */
+static inline int wchwidth(wchar_t wch)
+{
+	unsigned int c, w;
+
+	if (utf8locale == false)
+		return (wcwidth(wch));
+	c = (unsigned int)wch;
+	if (c >= 0x110000)
+		return (-1);
+	w = wcwidth_blocks[wcwidth_index[c >> 8]][(c & 0xff) >> 2];
+	w = (w >> ((c & 3) * 2)) & 3;
+
+	return (w == 3 ? -1 : (int)w);
+}
+
 unsigned int strcols(const char *mbstring);
+int
+strn_props(const char *mbstring, size_t len, unsigned int *cols,
+    bool *has_multi_col);
 int str_props(const char *mbstring, unsigned int *cols, bool *has_multi_col);
 void mvwaddwch(WINDOW *w, int y, int x, wchar_t wch);
 wchar_t* alloc_mbstows(const char *mbstring);
+wchar_t* arena_mbstows(struct arena *a, const char *mbstring);
+size_t mbnextchar(const char *mbstring, size_t len, int *cols);
 
 /* buttons */
 void
@@ -146,9 +182,7 @@ set_widget_size(struct bsddialog_conf *conf, int rows, int cols, int *h,
     int *w);
 
 int
-set_widget_autosize(struct bsddialog_conf *conf, int rows, int cols, int *h,
-    int *w, const char *text, int *rowstext, struct buttons *bs, int hnotext,
-    int minw);
+set_widget_autosize(struct dialog *d, int *rowstext, int hnotext, int minw);
 
 int widget_checksize(int h, int w, struct buttons *bs, int hnotext, int minw);
 
@@ -159,10 +193,15 @@ int dialog_size_position(struct dialog *d, int hnotext, int minw, int *htext);
 
 /* dialog */
 void end_dialog(struct dialog *d);
+void set_dialog_text(struct dialog *d, const char *text);
 int draw_dialog(struct dialog *d);
 
 int
 prepare_dialog(struct bsddialog_conf *conf, const char *text, int rows,
     int cols, struct dialog *d);
 
+/* arena allocator */
+void *arena_alloc(struct arena *a, size_t size);
+void arena_free(struct arena *a);
+
 #endif
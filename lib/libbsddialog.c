@@ -26,7 +26,10 @@
  */
 
 #include <curses.h>
+#include <langinfo.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "bsddialog.h"
 #include "bsddialog_theme.h"
@@ -35,6 +38,9 @@
 #define DEFAULT_COLS_PER_ROW  10   /* Default conf.text.columns_per_row */
 
 static bool in_bsddialog_mode = false;
+/* curses on /dev/tty if stdin is not a terminal, freed by bsddialog_end() */
+static FILE *ttyin = NULL;
+static SCREEN *ttyscreen = NULL;
 
 int bsddialog_init_notheme(void)
 {
@@ -42,7 +48,17 @@ int bsddialog_init_notheme(void)
 
 	set_error_string("");
 
-	if (initscr() == NULL)
+	/* stdin could be a pipe, for example bsddialog_textbox_fd() */
+	ttyin = NULL;
+	if (isatty(STDIN_FILENO) == 0)
+		ttyin = fopen("/dev/tty", "r");
+	if (ttyin != NULL) {
+		if ((ttyscreen = newterm(NULL, stdout, ttyin)) == NULL) {
+			fclose(ttyin);
+			ttyin = NULL;
+			RETURN_ERROR("Cannot init curses (newterm)");
+		}
+	} else if (initscr() == NULL)
 		RETURN_ERROR("Cannot init curses (initscr)");
 
 	error = OK;
@@ -68,6 +84,9 @@ int bsddialog_init_notheme(void)
 
 	hastermcolors = (error == OK && has_colors()) ? true : false;
 
+	/* wchar_t is Unicode in UTF-8 locales, see wchwidth() */
+	utf8locale = (strcmp(nl_langinfo(CODESET), "UTF-8") == 0);
+
 	return (BSDDIALOG_OK);
 }
 
@@ -97,6 +116,15 @@ int bsddialog_end(void)
 		RETURN_ERROR("Cannot end curses (endwin)");
 	in_bsddialog_mode = false;
 
+	if (ttyscreen != NULL) {
+		delscreen(ttyscreen);
+		ttyscreen = NULL;
+	}
+	if (ttyin != NULL) {
+		fclose(ttyin);
+		ttyin = NULL;
+	}
+
 	return (BSDDIALOG_OK);
 }
 
@@ -25,8 +25,15 @@
  * SUCH DAMAGE.
  */
 
+#include <ctype.h>
 #include <curses.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wctype.h>
 
 #include "bsddialog.h"
 #include "bsddialog_theme.h"
@@ -53,10 +60,61 @@ struct privateitem {
 	wchar_t shortcut;
 };
 
+#define FILTERLEN        64   /* bytes of the type-to-filter string */
+#define FILTERCHUNK      4096 /* candidates checked for each tick */
+#define FUZZYTOPK        256  /* best fuzzy matches in view */
+#define FUZZYKEYLEN      256  /* chars of name and desc to score */
+#define FUZZYMATCH       16
+#define FUZZYBOUNDARY    8    /* first char of a word */
+#define FUZZYCONSECUTIVE 4
+#define FUZZYGAPSTART    3
+#define FUZZYGAPEXT      1
+#define STREAMTIMEOUT    100  /* ms, bsddialog_menu_fd() */
+#define STREAMMAXREAD    (1024 * 1024) /* bytes for each timeout */
+
+enum filtermode {
+	NOFILTER,
+	SUBSTRFILTER,
+	FUZZYFILTER
+};
+
+/*
+ * Items matching the filter with len bytes, the candidates are a superset:
+ * the items of the previous level or of the index for the first char.
+ */
+struct filterlevel {
+	int len;
+	int *candidates;
+	int ncandidates;
+	bool owncandidates;
+	int next;                 /* candidates already checked */
+	int nitems;
+	int *items;
+};
+
+struct fuzzymatch {
+	int score;
+	int item;
+};
+
+/* bsddialog_menu_fd(), an item for each line: name or name TAB desc */
+struct menustream {
+	int fd;                   /* -1 at EOF, closed by the caller */
+	char *cur;                /* incomplete line */
+	size_t curlen;
+	size_t cursize;
+	int maxitems;             /* allocated private items */
+	unsigned int maxname;
+	unsigned int maxdesc;
+	int focus;                /* API focusitem until the first key */
+	unsigned int ticks;       /* progress while loading */
+	char *name;               /* focus item at the end, for the caller */
+};
+
 struct privatemenu {
 	WINDOW *box;              /* only for borders */
-	WINDOW *pad;              /* pad for the private items */
-	int ypad;                 /* start pad line */
+	WINDOW *pad;              /* pad for the visible items */
+	int ypad;                 /* first visible item */
 	int ys, ye, xs, xe;       /* pad pos */
 	unsigned int xselector;   /* [] */
 	unsigned int xname;       /* real x: xname + item.depth */
@@ -65,11 +123,39 @@ struct privatemenu {
 	unsigned int apimenurows;
 	unsigned int menurows;    /* real menurows after menu_size_position() */
 	int nitems;               /* total nitems (all groups * all items) */
+	struct menustream *stream; /* items from a fd, NULL for the groups */
 	struct privateitem *pritems;
-	int sel;                  /* current focus item, can be -1 */
+	int *nextsel;             /* next not separator item, -1 if none */
+	int *prevsel;             /* previous not separator item, -1 if none */
+	int firstsel;
+	int lastsel;
+	int *groupfirst;          /* item of the first item of each group */
+	int *view;                /* filtered items, NULL for all the items */
+	int nview;                /* items in view */
+	int sel;                  /* current focus in view, can be -1 */
 	bool hasbottomdesc;
+	/* type-to-filter */
+	enum filtermode filtermode;
+	char filter[FILTERLEN + 1];
+	wchar_t wfilter[FILTERLEN]; /* a char for each level, folded */
+	int nlevels;
+	struct filterlevel levels[FILTERLEN];
+	int *index;               /* items with a byte, by byte */
+	int nindexed;             /* items in index, -1 before the first char */
+	int indexpos[UCHAR_MAX + 2];
+	int ntopk;
+	struct fuzzymatch topk[FUZZYTOPK]; /* heap, the worst on top */
+	int topkview[FUZZYTOPK];
 };
 
+/* item of the position v in the view */
+#define ITEM(m, v) ((m)->view == NULL ? (v) : (m)->view[(v)])
+#define FOCUSITEM(m) ((m)->sel >= 0 ? ITEM(m, (m)->sel) : -1)
+#define FILTERPENDING(m) ((m)->nlevels > 0 &&                                  \
+	(m)->levels[(m)->nlevels - 1].next <                                   \
+	(m)->levels[(m)->nlevels - 1].ncandidates)
+#define STREAMLOADING(m) ((m)->stream != NULL && (m)->stream->fd >= 0)
+
 static enum menumode
 getmode(enum menumode mode, struct bsddialog_menugroup group)
 {
@@ -85,10 +171,83 @@ getmode(enum menumode mode, struct bsddialog_menugroup group)
 	return (mode);
 }
 
+static const char *
+filterkey(struct bsddialog_conf *conf, struct privateitem *pritem)
+{
+	return (conf->menu.no_name ? pritem->desc : pritem->name);
+}
+
+/* name and desc, NULL if hidden */
+static const char *
+indexkey(struct bsddialog_conf *conf, struct privateitem *pritem, int k)
+{
+	if (k == 0)
+		return (conf->menu.no_name ? NULL : pritem->name);
+	return (conf->menu.no_desc ? NULL : pritem->desc);
+}
+
+/*
+ * Index for the first char of the filter: the items with a (case folded)
+ * byte in their name or desc, the next chars refine the previous matches.
+ * Built by the first char, again if a stream has added items.
+ */
 static int
-build_privatemenu(struct bsddialog_conf *conf, struct privatemenu *m,
-    enum menumode mode, unsigned int ngroups,
-    struct bsddialog_menugroup *groups)
+build_filterindex(struct bsddialog_conf *conf, struct privatemenu *m)
+{
+	int i, k, b, last[UCHAR_MAX + 1], next[UCHAR_MAX + 1];
+	const unsigned char *key;
+
+	memset(m->indexpos, 0, sizeof(m->indexpos));
+	for (b = 0; b <= UCHAR_MAX; b++)
+		last[b] = -1;
+	for (i = 0; i < m->nitems; i++) {
+		if (m->pritems[i].type == SEPARATORMODE)
+			continue;
+		for (k = 0; k < 2; k++) {
+			key = (const unsigned char *)
+			    indexkey(conf, &m->pritems[i], k);
+			for (; key != NULL && *key != '\0'; key++) {
+				b = tolower(*key);
+				if (last[b] != i) {
+					last[b] = i;
+					m->indexpos[b + 1]++;
+				}
+			}
+		}
+	}
+	for (b = 0; b <= UCHAR_MAX; b++) {
+		m->indexpos[b + 1] += m->indexpos[b];
+		next[b] = m->indexpos[b];
+		last[b] = -1;
+	}
+
+	free(m->index);
+	m->index = calloc(MAX(m->indexpos[UCHAR_MAX + 1], 1), sizeof(int));
+	if (m->index == NULL)
+		RETURN_ERROR("Cannot allocate memory for menu filter index");
+	m->nindexed = m->nitems;
+	for (i = 0; i < m->nitems; i++) {
+		if (m->pritems[i].type == SEPARATORMODE)
+			continue;
+		for (k = 0; k < 2; k++) {
+			key = (const unsigned char *)
+			    indexkey(conf, &m->pritems[i], k);
+			for (; key != NULL && *key != '\0'; key++) {
+				b = tolower(*key);
+				if (last[b] != i) {
+					last[b] = i;
+					m->index[next[b]++] = i;
+				}
+			}
+		}
+	}
+
+	return (0);
+}
+
+static int
+build_privatemenu(struct dialog *d, struct privatemenu *m, enum menumode mode,
+    unsigned int ngroups, struct bsddialog_menugroup *groups)
 {
 	bool onetrue;
 	int i, j, abs;
@@ -106,13 +265,19 @@ build_privatemenu(struct bsddialog_conf *conf, struct privatemenu *m,
 	}
 
 	/* alloc and set private items */
-	m->pritems = calloc(m->nitems, sizeof (struct privateitem));
-	if (m->pritems == NULL)
+	m->pritems = arena_alloc(&d->arena,
+	    m->nitems * sizeof(struct privateitem));
+	m->nextsel = arena_alloc(&d->arena, m->nitems * sizeof(int));
+	m->prevsel = arena_alloc(&d->arena, m->nitems * sizeof(int));
+	m->groupfirst = arena_alloc(&d->arena, ngroups * sizeof(int));
+	if (m->pritems == NULL || m->nextsel == NULL || m->prevsel == NULL ||
+	    m->groupfirst == NULL)
 		RETURN_ERROR("Cannot allocate memory for internal menu items");
 	m->hasbottomdesc = false;
 	abs = 0;
 	for (i = 0; i < (int)ngroups; i++) {
 		onetrue = false;
+		m->groupfirst[i] = abs;
 		for (j = 0; j < (int)groups[i].nitems; j++) {
 			item = &groups[i].items[j];
 			pritem = &m->pritems[abs];
@@ -138,13 +303,27 @@ build_privatemenu(struct bsddialog_conf *conf, struct privatemenu *m,
 			if (item->bottomdesc != NULL)
 				m->hasbottomdesc = true;
 
-			mbtowc(&pritem->shortcut, conf->menu.no_name ?
+			mbtowc(&pritem->shortcut, d->conf->menu.no_name ?
 			    pritem->desc : pritem->name, MB_CUR_MAX);
 
 			abs++;
 		}
 	}
 
+	/* links to skip the separators */
+	m->firstsel = -1;
+	for (i = m->nitems - 1; i >= 0; i--) {
+		m->nextsel[i] = m->firstsel;
+		if (m->pritems[i].type != SEPARATORMODE)
+			m->firstsel = i;
+	}
+	m->lastsel = -1;
+	for (i = 0; i < m->nitems; i++) {
+		m->prevsel[i] = m->lastsel;
+		if (m->pritems[i].type != SEPARATORMODE)
+			m->lastsel = i;
+	}
+
 	/* positions */
 	m->xselector = m->xname = m->xdesc = m->line = 0;
 	maxsepstr = maxprefix = selectorlen = maxdepth = maxname = maxdesc = 0;
@@ -165,8 +344,8 @@ build_privatemenu(struct bsddialog_conf *conf, struct privatemenu *m,
 		maxname   = MAX(maxname, strcols(m->pritems[i].name));
 		maxdesc   = MAX(maxdesc, strcols(m->pritems[i].desc));
 	}
-	maxname = conf->menu.no_name ? 0 : maxname;
-	maxdesc = conf->menu.no_desc ? 0 : maxdesc;
+	maxname = d->conf->menu.no_name ? 0 : maxname;
+	maxdesc = d->conf->menu.no_desc ? 0 : maxdesc;
 
 	m->xselector = maxprefix + (maxprefix != 0 ? 1 : 0);
 	m->xname = m->xselector + selectorlen;
@@ -177,6 +356,184 @@ build_privatemenu(struct bsddialog_conf *conf, struct privatemenu *m,
 	return (0);
 }
 
+/* the stream has only MENUMODE items, without prefix and depth */
+static void
+stream_positions(struct bsddialog_conf *conf, struct privatemenu *m)
+{
+	unsigned int maxname, maxdesc;
+
+	maxname = conf->menu.no_name ? 0 : m->stream->maxname;
+	maxdesc = conf->menu.no_desc ? 0 : m->stream->maxdesc;
+	m->xselector = m->xname = 0;
+	m->xdesc = maxname + (maxname != 0 ? 1 : 0);
+	m->line = MAX(3, m->xdesc + maxdesc);
+}
+
+static void
+build_streammenu(struct dialog *d, struct privatemenu *m, struct menustream *s)
+{
+	m->stream = s;
+	m->nitems = 0;
+	m->pritems = NULL;
+	m->nextsel = m->prevsel = NULL;
+	m->firstsel = m->lastsel = -1;
+	m->groupfirst = NULL;
+	m->hasbottomdesc = false;
+	stream_positions(d->conf, m);
+}
+
+static int
+stream_additem(struct bsddialog_conf *conf, struct privatemenu *m,
+    const char *str, size_t len)
+{
+	int i, maxitems, *sel;
+	char *line, *tab;
+	struct privateitem *pritem, *pritems;
+	struct menustream *s = m->stream;
+
+	if (m->nitems == s->maxitems) {
+		maxitems = MAX(s->maxitems * 2, 64);
+		/* the arrays are updated one by one, nitems stays valid */
+		if ((pritems = realloc(m->pritems,
+		    maxitems * sizeof(struct privateitem))) == NULL)
+			RETURN_ERROR("Cannot allocate memory for menu items");
+		m->pritems = pritems;
+		if ((sel = realloc(m->nextsel, maxitems * sizeof(int))) == NULL)
+			RETURN_ERROR("Cannot allocate memory for menu items");
+		m->nextsel = sel;
+		if ((sel = realloc(m->prevsel, maxitems * sizeof(int))) == NULL)
+			RETURN_ERROR("Cannot allocate memory for menu items");
+		m->prevsel = sel;
+		s->maxitems = maxitems;
+	}
+	if ((line = malloc(len + 1)) == NULL)
+		RETURN_ERROR("Cannot allocate memory for menu item");
+	memcpy(line, str, len);
+	line[len] = '\0';
+
+	i = m->nitems;
+	pritem = &m->pritems[i];
+	pritem->prefix = "";
+	pritem->on = false;
+	pritem->depth = 0;
+	pritem->name = line;
+	pritem->desc = line + len;
+	if ((tab = strchr(line, '\t')) != NULL) {
+		*tab = '\0';
+		pritem->desc = tab + 1;
+	}
+	pritem->bottomdesc = "";
+	pritem->group = 0;
+	pritem->index = i;
+	pritem->type = MENUMODE;
+	mbtowc(&pritem->shortcut, conf->menu.no_name ?
+	    pritem->desc : pritem->name, MB_CUR_MAX);
+	s->maxname = MAX(s->maxname, strcols(pritem->name));
+	s->maxdesc = MAX(s->maxdesc, strcols(pritem->desc));
+
+	/* links, no separators */
+	m->nextsel[i] = -1;
+	m->prevsel[i] = m->lastsel;
+	if (m->lastsel >= 0)
+		m->nextsel[m->lastsel] = i;
+	else
+		m->firstsel = i;
+	m->lastsel = i;
+	m->nitems++;
+
+	return (0);
+}
+
+/* a line for each item, the empty lines are ignored */
+static int
+stream_append(struct bsddialog_conf *conf, struct privatemenu *m,
+    const char *data, size_t size)
+{
+	size_t len;
+	const char *p, *end, *nl;
+	struct menustream *s = m->stream;
+
+	p = data;
+	end = data + size;
+	while (p < end) {
+		nl = memchr(p, '\n', end - p);
+		len = (nl == NULL) ? (size_t)(end - p) : (size_t)(nl - p);
+		if (s->curlen + len > s->cursize) {
+			s->cursize = MAX(s->cursize * 2, s->curlen + len);
+			if ((s->cur = realloc(s->cur, s->cursize)) == NULL)
+				RETURN_ERROR("Cannot allocate menu stream line");
+		}
+		memcpy(s->cur + s->curlen, p, len);
+		s->curlen += len;
+		if (nl == NULL)
+			break;
+		if (s->curlen > 0 &&
+		    stream_additem(conf, m, s->cur, s->curlen) != 0)
+			return (BSDDIALOG_ERROR);
+		s->curlen = 0;
+		p = nl + 1;
+	}
+
+	return (0);
+}
+
+/* Returns 1 if new data or EOF, the UI is updated at most each MAXREAD. */
+static int read_menustream(struct bsddialog_conf *conf, struct privatemenu *m)
+{
+	char buf[BUFSIZ];
+	int changed;
+	size_t total;
+	ssize_t n;
+	struct pollfd pfd;
+	struct menustream *s = m->stream;
+
+	changed = 0;
+	total = 0;
+	while (s->fd >= 0 && total < STREAMMAXREAD) {
+		pfd.fd = s->fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, 0) <= 0)
+			break;
+		if ((n = read(s->fd, buf, sizeof(buf))) < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			RETURN_ERROR("Cannot read menu file descriptor");
+		}
+		changed = 1;
+		if (n == 0) {
+			s->fd = -1; /* EOF, fd is closed by the caller */
+			if (s->curlen > 0 &&
+			    stream_additem(conf, m, s->cur, s->curlen) != 0)
+				return (BSDDIALOG_ERROR);
+			break;
+		}
+		if (stream_append(conf, m, buf, n) != 0)
+			return (BSDDIALOG_ERROR);
+		total += n;
+	}
+
+	return (changed);
+}
+
+/* the focus item is not freed, it is the name for the caller */
+static void close_menustream(struct privatemenu *m, int focus)
+{
+	int i;
+	struct menustream *s = m->stream;
+
+	s->name = NULL;
+	for (i = 0; i < m->nitems; i++) {
+		if (i == focus)
+			s->name = (char *)m->pritems[i].name;
+		else
+			free((char *)m->pritems[i].name);
+	}
+	free(m->pritems);
+	free(m->nextsel);
+	free(m->prevsel);
+	free(s->cur);
+}
+
 static void
 set_return_on(struct privatemenu *m, struct bsddialog_menugroup *groups)
 {
@@ -191,39 +548,39 @@ set_return_on(struct privatemenu *m, struct bsddialog_menugroup *groups)
 	}
 }
 
-static int getprev(struct privateitem *pritems, int abs)
+/*
+ * Navigation in constant time: a filtered view has no separators, the full
+ * list follows the links of build_privatemenu().
+ */
+static int getprev(struct privatemenu *m, int v)
 {
-	int i;
+	int prev;
 
-	for (i = abs - 1; i >= 0; i--) {
-		if (pritems[i].type == SEPARATORMODE)
-			continue;
-		return (i);
-	}
+	if (m->view != NULL)
+		return (v > 0 ? v - 1 : v);
+	prev = (v >= m->nitems) ? m->lastsel : (v > 0 ? m->prevsel[v] : -1);
 
-	return (abs);
+	return (prev >= 0 ? prev : v);
 }
 
-static int getnext(int npritems, struct privateitem *pritems, int abs)
+static int getnext(struct privatemenu *m, int v)
 {
-	int i;
+	int next;
 
-	for (i = abs + 1; i < npritems; i++) {
-		if (pritems[i].type == SEPARATORMODE)
-			continue;
-		return (i);
-	}
+	if (m->view != NULL)
+		return (v + 1 < m->nview ? v + 1 : v);
+	next = (v < 0) ? m->firstsel : (v < m->nitems ? m->nextsel[v] : -1);
 
-	return (abs);
+	return (next >= 0 ? next : v);
 }
 
 static int
-getfirst_with_default(int npritems, struct privateitem *pritems, int ngroups,
+getfirst_with_default(struct privatemenu *m, int ngroups,
     struct bsddialog_menugroup *groups, int *focusgroup, int *focusitem)
 {
-	int i, abs;
+	int abs;
 
-	if ((abs =  getnext(npritems, pritems, -1)) < 0)
+	if ((abs =  getnext(m, -1)) < 0)
 		return (abs);
 
 	if (focusgroup == NULL || focusitem == NULL)
@@ -235,106 +592,104 @@ getfirst_with_default(int npritems, struct privateitem *pritems, int ngroups,
 	if (*focusitem < 0 || *focusitem >= (int)groups[*focusgroup].nitems)
 		return (abs);
 
-	for (i = abs; i < npritems; i++) {
-		if (pritems[i].group == *focusgroup &&
-		    pritems[i].index == *focusitem)
-			return (i);
-	}
-
-	return (abs);
+	return (m->groupfirst[*focusgroup] + *focusitem);
 }
 
-static int
-getfastnext(int menurows, int npritems, struct privateitem *pritems, int abs)
+/* the first item at least menurows after v, otherwise the last one */
+static int getfastnext(struct privatemenu *m, int v)
 {
-	int a, start, i;
+	int target;
 
-	start = abs;
-	i = menurows;
-	do {
-		a = abs;
-		abs = getnext(npritems, pritems, abs);
-		i--;
-	} while (abs != a && abs < start + menurows && i > 0);
+	target = v + m->menurows;
+	if (m->view != NULL)
+		return (MIN(target, m->nview - 1));
+	if (target >= m->nitems || m->nextsel[target - 1] < 0)
+		return (MAX(m->lastsel, v));
 
-	return (abs);
+	return (m->nextsel[target - 1]);
 }
 
-static int
-getfastprev(int menurows, struct privateitem *pritems, int abs)
+/* the last item at least menurows before v, otherwise the first one */
+static int getfastprev(struct privatemenu *m, int v)
 {
-	int a, start, i;
+	int target;
 
-	start = abs;
-	i = menurows;
-	do {
-		a = abs;
-		abs = getprev(pritems, abs);
-		i--;
-	} while (abs != a && abs > start - menurows && i > 0);
+	target = v - m->menurows;
+	if (m->view != NULL)
+		return (MAX(target, 0));
+	if (target < 0 || m->prevsel[target + 1] < 0)
+		return (MIN(m->firstsel, v));
 
-	return (abs);
+	return (m->prevsel[target + 1]);
 }
 
-static int
-getnextshortcut(int npritems, struct privateitem *pritems, int abs, wint_t key)
+static int getnextshortcut(struct privatemenu *m, int v, wint_t key)
 {
 	int i, next;
+	struct privateitem *pritem;
 
 	next = -1;
-	for (i = 0; i < npritems; i++) {
-		if (pritems[i].type == SEPARATORMODE)
+	for (i = 0; i < m->nview; i++) {
+		pritem = &m->pritems[ITEM(m, i)];
+		if (pritem->type == SEPARATORMODE)
 			continue;
-		if (pritems[i].shortcut == (wchar_t)key) {
-			if (i > abs)
+		if (pritem->shortcut == (wchar_t)key) {
+			if (i > v)
 				return (i);
-			if (i < abs && next == -1)
+			if (i < v && next == -1)
 				next = i;
 		}
 	}
 
-	return (next != -1 ? next : abs);
+	return (next != -1 ? next : v);
 }
 
-static void drawseparators(struct bsddialog_conf *conf, struct privatemenu *m)
+static void
+drawseparator(struct bsddialog_conf *conf, struct privatemenu *m, int y, int i)
 {
-	int i, realw, labellen;
+	int realw, labellen;
 	const char *desc, *name;
 
-	for (i = 0; i < m->nitems; i++) {
-		if (m->pritems[i].type != SEPARATORMODE)
-			continue;
-		if (conf->no_lines == false) {
-			wattron(m->pad, t.menu.desccolor);
-			if (conf->ascii_lines)
-				mvwhline(m->pad, i, 0, '-', m->line);
-			else
-				mvwhline_set(m->pad, i, 0, WACS_HLINE, m->line);
-			wattroff(m->pad, t.menu.desccolor);
-		}
-		name = m->pritems[i].name;
-		desc = m->pritems[i].desc;
-		realw = m->xe - m->xs;
-		labellen = strcols(name) + strcols(desc) + 1;
-		wmove(m->pad, i, (labellen < realw) ? realw/2 - labellen/2 : 0);
-		wattron(m->pad, t.menu.sepnamecolor);
-		waddstr(m->pad, name);
-		wattroff(m->pad, t.menu.sepnamecolor);
-		if (strcols(name) > 0 && strcols(desc) > 0)
-			waddch(m->pad, ' ');
-		wattron(m->pad, t.menu.sepdesccolor);
-		waddstr(m->pad, desc);
-		wattroff(m->pad, t.menu.sepdesccolor);
+	if (conf->no_lines == false) {
+		wattron(m->pad, t.menu.desccolor);
+		if (conf->ascii_lines)
+			mvwhline(m->pad, y, 0, '-', m->line);
+		else
+			mvwhline_set(m->pad, y, 0, WACS_HLINE, m->line);
+		wattroff(m->pad, t.menu.desccolor);
 	}
+	name = m->pritems[i].name;
+	desc = m->pritems[i].desc;
+	realw = m->xe - m->xs;
+	labellen = strcols(name) + strcols(desc) + 1;
+	wmove(m->pad, y, (labellen < realw) ? realw/2 - labellen/2 : 0);
+	wattron(m->pad, t.menu.sepnamecolor);
+	waddstr(m->pad, name);
+	wattroff(m->pad, t.menu.sepnamecolor);
+	if (strcols(name) > 0 && strcols(desc) > 0)
+		waddch(m->pad, ' ');
+	wattron(m->pad, t.menu.sepdesccolor);
+	waddstr(m->pad, desc);
+	wattroff(m->pad, t.menu.sepdesccolor);
 }
 
+/* the pad has only the visible items, y is the pad row of the view v */
 static void
-drawitem(struct bsddialog_conf *conf, struct privatemenu *m, int y, bool focus)
+drawitem(struct bsddialog_conf *conf, struct privatemenu *m, int v, bool focus)
 {
-	int colordesc, colorname, colorshortcut;
+	int y, colordesc, colorname, colorshortcut;
 	struct privateitem *pritem;
 
-	pritem = &m->pritems[y];
+	y = v - m->ypad;
+	if (y < 0 || y >= getmaxy(m->pad))
+		return;
+	pritem = &m->pritems[ITEM(m, v)];
+	wmove(m->pad, y, 0);
+	wclrtoeol(m->pad);
+	if (pritem->type == SEPARATORMODE) {
+		drawseparator(conf, m, y, ITEM(m, v));
+		return;
+	}
 
 	/* prefix */
 	wattron(m->pad, focus ? t.menu.f_prefixcolor : t.menu.prefixcolor);
@@ -383,38 +738,432 @@ drawitem(struct bsddialog_conf *conf, struct privatemenu *m, int y, bool focus)
 		wattroff(m->pad, colorshortcut);
 	}
 
-	/* bottom description */
-	if (m->hasbottomdesc) {
+	/* bottom description, the items are not drawn in order */
+	if (m->hasbottomdesc && focus) {
 		move(SCREENLINES - 1, 2);
 		clrtoeol();
-		if (focus) {
-			attron(t.menu.bottomdesccolor);
-			addstr(pritem->bottomdesc);
-			attroff(t.menu.bottomdesccolor);
-			refresh();
-		}
+		attron(t.menu.bottomdesccolor);
+		addstr(pritem->bottomdesc);
+		attroff(t.menu.bottomdesccolor);
+		refresh();
 	}
 }
 
+static void drawitems(struct bsddialog_conf *conf, struct privatemenu *m)
+{
+	int i;
+
+	werase(m->pad);
+	for (i = m->ypad; i < m->nview && i < m->ypad + getmaxy(m->pad); i++)
+		drawitem(conf, m, i, i == m->sel);
+}
+
 static void update_menubox(struct bsddialog_conf *conf, struct privatemenu *m)
 {
-	int h, w;
+	int h, w, cols, len;
+	size_t charlen;
+	const char *filter;
+	char progress[32];
 
 	draw_borders(conf, m->box, LOWERED);
 	getmaxyx(m->box, h, w);
 
-	if (m->nitems > (int)m->menurows) {
+	if (m->nview > (int)m->menurows) {
 		wattron(m->box, t.dialog.arrowcolor);
 		if (m->ypad > 0)
 			mvwhline(m->box, 0, 2, UARROW(conf), 3);
 
-		if ((m->ypad + (int)m->menurows) < m->nitems)
+		if ((m->ypad + (int)m->menurows) < m->nview)
 			mvwhline(m->box, h-1, 2, DARROW(conf), 3);
 
 		mvwprintw(m->box, h-1, w-6, "%3d%%",
-		    100 * (m->ypad + m->menurows) / m->nitems);
+		    100 * (m->ypad + m->menurows) / m->nview);
 		wattroff(m->box, t.dialog.arrowcolor);
 	}
+
+	/* filter between the arrows and the percentage, the end if long */
+	if (m->filtermode != NOFILTER && w > 13) {
+		filter = m->filter;
+		while ((int)strcols(filter) > w - 14) {
+			if ((charlen = mbnextchar(filter, strlen(filter),
+			    &cols)) == 0)
+				break;
+			filter += charlen;
+		}
+		wattron(m->box, t.dialog.arrowcolor);
+		mvwaddch(m->box, h-1, 6,
+		    m->filtermode == FUZZYFILTER ? '~' : '/');
+		waddstr(m->box, filter);
+		wattroff(m->box, t.dialog.arrowcolor);
+	}
+
+	/* loaded items while the stream is open, after the up arrow */
+	if (m->stream != NULL && m->stream->fd >= 0) {
+		len = snprintf(progress, sizeof(progress), " %d %c ", m->nitems,
+		    "-\\|/"[m->stream->ticks % 4]);
+		if (len + 8 <= w) {
+			wattron(m->box, t.dialog.arrowcolor);
+			mvwaddstr(m->box, 0, w - len - 2, progress);
+			wattroff(m->box, t.dialog.arrowcolor);
+		}
+	}
+}
+
+static void refresh_menu(struct bsddialog_conf *conf, struct privatemenu *m)
+{
+	drawitems(conf, m);
+	update_menubox(conf, m);
+	wnoutrefresh(m->box);
+	pnoutrefresh(m->pad, 0, 0, m->ys, m->xs, m->ye, m->xe);
+}
+
+/* the focus goes to item if it is in view, otherwise to the first item */
+static void set_view(struct privatemenu *m, int *view, int nview, int item)
+{
+	int i;
+
+	m->view = view;
+	m->nview = nview;
+	m->sel = -1;
+	for (i = 0; i < m->nview && item >= 0; i++) {
+		if (ITEM(m, i) == item) {
+			m->sel = i;
+			break;
+		}
+	}
+	if (m->sel < 0)
+		m->sel = getnext(m, -1);
+
+	if (m->ypad > m->sel && m->ypad > 0)
+		m->ypad = MAX(m->sel, 0);
+	if ((int)(m->ypad + m->menurows) <= m->sel)
+		m->ypad = m->sel - m->menurows + 1;
+	if (m->ypad > 0 && (m->nview - m->ypad) < (int)m->menurows)
+		m->ypad = MAX(m->nview - (int)m->menurows, 0);
+}
+
+/* chars folded like the index, only ASCII */
+static int foldkey(const char *key, wchar_t *wkey)
+{
+	int n;
+	size_t len, charlen;
+	wchar_t wch;
+	mbstate_t mbs;
+
+	memset(&mbs, 0, sizeof(mbs));
+	len = strlen(key);
+	for (n = 0; n < FUZZYKEYLEN && len > 0; n++) {
+		if ((unsigned char)*key < 0x80) {
+			wch = tolower((unsigned char)*key);
+			charlen = 1;
+		} else {
+			charlen = mbrtowc(&wch, key, len, &mbs);
+			if (charlen == 0 || charlen > len)
+				break;
+		}
+		wkey[n] = wch;
+		key += charlen;
+		len -= charlen;
+	}
+
+	return (n);
+}
+
+/*
+ * Subsequence score in the style of fzf: the shortest window of key ending
+ * at the first full match, bonus for a char at the start of a word and for
+ * consecutive chars, penalty for the gaps.
+ */
+static bool
+fuzzy_score(const wchar_t *p, int np, const wchar_t *key, int nkey, int *score)
+{
+	bool prevmatch;
+	int i, pi, start, end;
+
+	for (i = 0, pi = 0; i < nkey && pi < np; i++)
+		if (key[i] == p[pi])
+			pi++;
+	if (pi < np)
+		return (false);
+	end = i;
+	for (i = end - 1, pi = np - 1; pi >= 0; i--)
+		if (key[i] == p[pi])
+			pi--;
+	start = i + 1;
+
+	*score = 0;
+	prevmatch = false;
+	for (i = start, pi = 0; i < end; i++) {
+		if (pi < np && key[i] == p[pi]) {
+			*score += FUZZYMATCH;
+			if (i == 0 || iswalnum(key[i - 1]) == 0)
+				*score += FUZZYBOUNDARY;
+			if (prevmatch)
+				*score += FUZZYCONSECUTIVE;
+			prevmatch = true;
+			pi++;
+		} else {
+			*score -= prevmatch ? FUZZYGAPSTART : FUZZYGAPEXT;
+			prevmatch = false;
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * The best score of name and desc, a desc match is worth half: a positive
+ * score is halved and a negative one doubled, it never gets better.
+ */
+static bool
+fuzzy_item(struct bsddialog_conf *conf, struct privatemenu *m, int item,
+    int *score)
+{
+	bool match;
+	int k, nkey, s;
+	const char *key;
+	wchar_t wkey[FUZZYKEYLEN];
+
+	match = false;
+	for (k = 0; k < 2; k++) {
+		if ((key = indexkey(conf, &m->pritems[item], k)) == NULL)
+			continue;
+		nkey = foldkey(key, wkey);
+		if (fuzzy_score(m->wfilter, m->nlevels, wkey, nkey, &s) == false)
+			continue;
+		if (k == 1 && conf->menu.no_name == false)
+			s = (s > 0) ? s / 2 : s * 2;
+		*score = match ? MAX(*score, s) : s;
+		match = true;
+	}
+
+	return (match);
+}
+
+static bool better(struct fuzzymatch *a, struct fuzzymatch *b)
+{
+	return (a->score > b->score ||
+	    (a->score == b->score && a->item < b->item));
+}
+
+static int fuzzycmp(const void *a, const void *b)
+{
+	return (better((struct fuzzymatch *)a, (struct fuzzymatch *)b) ?
+	    -1 : 1);
+}
+
+/* the heap keeps the FUZZYTOPK best matches */
+static void topk_add(struct privatemenu *m, int item, int score)
+{
+	int i, c;
+	struct fuzzymatch new;
+
+	new.score = score;
+	new.item = item;
+	if (m->ntopk < FUZZYTOPK) {
+		for (i = m->ntopk++; i > 0; i = (i - 1) / 2) {
+			if (better(&new, &m->topk[(i - 1) / 2]))
+				break;
+			m->topk[i] = m->topk[(i - 1) / 2];
+		}
+		m->topk[i] = new;
+		return;
+	}
+	if (better(&new, &m->topk[0]) == false)
+		return;
+	for (i = 0; (c = 2 * i + 1) < m->ntopk; i = c) {
+		if (c + 1 < m->ntopk && better(&m->topk[c], &m->topk[c + 1]))
+			c++;
+		if (better(&m->topk[c], &new))
+			break;
+		m->topk[i] = m->topk[c];
+	}
+	m->topk[i] = new;
+}
+
+/* a chunk of the candidates, the view shows the matches so far */
+static void filter_step(struct bsddialog_conf *conf, struct privatemenu *m)
+{
+	int i, end, item, score, candidate;
+	struct filterlevel *level;
+	struct fuzzymatch ranked[FUZZYTOPK];
+
+	level = &m->levels[m->nlevels - 1];
+	item = FOCUSITEM(m);
+	/* the best fuzzy match has the focus until the user moves */
+	if (m->filtermode == FUZZYFILTER && (level->next == 0 || m->sel <= 0))
+		item = -1;
+
+	end = MIN(level->next + FILTERCHUNK, level->ncandidates);
+	for (i = level->next; i < end; i++) {
+		candidate = level->candidates[i];
+		if (m->filtermode == FUZZYFILTER) {
+			if (fuzzy_item(conf, m, candidate, &score) == false)
+				continue;
+			topk_add(m, candidate, score);
+		} else if (strcasestr(filterkey(conf, &m->pritems[candidate]),
+		    m->filter) == NULL) {
+			continue;
+		}
+		level->items[level->nitems++] = candidate;
+	}
+	level->next = end;
+
+	if (m->filtermode == FUZZYFILTER) {
+		memcpy(ranked, m->topk, m->ntopk * sizeof(struct fuzzymatch));
+		qsort(ranked, m->ntopk, sizeof(struct fuzzymatch), fuzzycmp);
+		for (i = 0; i < m->ntopk; i++)
+			m->topkview[i] = ranked[i].item;
+		set_view(m, m->topkview, m->ntopk, item);
+	} else {
+		set_view(m, level->items, level->nitems, item);
+	}
+}
+
+/*
+ * The new char refines the matches of the previous filter, the candidates
+ * not yet checked by the previous level are checked by the new one.
+ */
+static int
+addfilter(struct bsddialog_conf *conf, struct privatemenu *m, wint_t input)
+{
+	int len, charlen, b, n;
+	char mb[MB_LEN_MAX];
+	struct filterlevel *level, *prev;
+
+	len = strlen(m->filter);
+	if ((charlen = wctomb(mb, input)) <= 0 || len + charlen > FILTERLEN ||
+	    m->nlevels >= FILTERLEN)
+		return (0);
+	memcpy(m->filter + len, mb, charlen);
+	m->filter[len + charlen] = '\0';
+	m->wfilter[m->nlevels] = (input < 0x80) ? (wint_t)tolower(input) :
+	    input;
+
+	level = &m->levels[m->nlevels];
+	prev = (m->nlevels > 0) ? &m->levels[m->nlevels - 1] : NULL;
+	level->owncandidates = false;
+	if (prev == NULL && m->nindexed != m->nitems &&
+	    build_filterindex(conf, m) != 0)
+		return (BSDDIALOG_ERROR);
+	if (prev == NULL) {
+		b = tolower((unsigned char)m->filter[0]);
+		level->candidates = m->index + m->indexpos[b];
+		level->ncandidates = m->indexpos[b + 1] - m->indexpos[b];
+	} else if (prev->next >= prev->ncandidates) {
+		level->candidates = prev->items;
+		level->ncandidates = prev->nitems;
+	} else {
+		n = prev->ncandidates - prev->next;
+		level->ncandidates = prev->nitems + n;
+		level->candidates = calloc(MAX(level->ncandidates, 1),
+		    sizeof(int));
+		if (level->candidates == NULL)
+			RETURN_ERROR("Cannot allocate memory for menu filter");
+		level->owncandidates = true;
+		memcpy(level->candidates, prev->items,
+		    prev->nitems * sizeof(int));
+		memcpy(level->candidates + prev->nitems,
+		    prev->candidates + prev->next, n * sizeof(int));
+	}
+	if ((level->items = calloc(MAX(level->ncandidates, 1),
+	    sizeof(int))) == NULL)
+		RETURN_ERROR("Cannot allocate memory for menu filter");
+	level->len = len + charlen;
+	level->next = 0;
+	level->nitems = 0;
+	m->nlevels++;
+	m->ntopk = 0;
+	filter_step(conf, m);
+
+	return (0);
+}
+
+/*
+ * The items of a stream are candidates not yet checked by all the levels,
+ * from the last one: a level could use the items of the previous.
+ */
+static int filter_newitems(struct privatemenu *m, int first)
+{
+	int i, j, n, *candidates;
+	struct filterlevel *level;
+
+	n = m->nitems - first;
+	for (i = m->nlevels - 1; i >= 0; i--) {
+		level = &m->levels[i];
+		if (level->owncandidates) {
+			candidates = realloc(level->candidates,
+			    (level->ncandidates + n) * sizeof(int));
+		} else {
+			candidates = malloc((level->ncandidates + n) *
+			    sizeof(int));
+			if (candidates != NULL)
+				memcpy(candidates, level->candidates,
+				    level->ncandidates * sizeof(int));
+		}
+		if (candidates == NULL)
+			RETURN_ERROR("Cannot allocate memory for menu filter");
+		level->candidates = candidates;
+		level->owncandidates = true;
+		for (j = first; j < m->nitems; j++)
+			level->candidates[level->ncandidates++] = j;
+		level->items = realloc(level->items,
+		    level->ncandidates * sizeof(int));
+		if (level->items == NULL)
+			RETURN_ERROR("Cannot allocate memory for menu filter");
+	}
+	if (m->nlevels > 0 && m->view != m->topkview)
+		m->view = m->levels[m->nlevels - 1].items;
+
+	return (0);
+}
+
+static void freelevel(struct filterlevel *level)
+{
+	free(level->items);
+	if (level->owncandidates)
+		free(level->candidates);
+}
+
+/* the fuzzy scores of the previous filter are computed again */
+static void delfilter(struct bsddialog_conf *conf, struct privatemenu *m)
+{
+	struct filterlevel *last, *prev;
+
+	if (m->nlevels == 0)
+		return;
+	m->nlevels--;
+	last = &m->levels[m->nlevels];
+	if (m->nlevels == 0) {
+		m->filter[0] = '\0';
+		set_view(m, NULL, m->nitems, FOCUSITEM(m));
+	} else {
+		prev = &m->levels[m->nlevels - 1];
+		m->filter[prev->len] = '\0';
+		if (m->filtermode == FUZZYFILTER ||
+		    prev->next < prev->ncandidates) {
+			prev->next = 0;
+			prev->nitems = 0;
+			m->ntopk = 0;
+			filter_step(conf, m);
+		} else {
+			set_view(m, prev->items, prev->nitems, FOCUSITEM(m));
+		}
+	}
+	/* the focus item of the new view is read in the last level */
+	freelevel(last);
+}
+
+static void clearfilter(struct privatemenu *m)
+{
+	int item;
+
+	item = FOCUSITEM(m);
+	while (m->nlevels > 0)
+		freelevel(&m->levels[--m->nlevels]);
+	m->filter[0] = '\0';
+	m->ntopk = 0;
+	set_view(m, NULL, m->nitems, item);
 }
 
 static int menu_size_position(struct dialog *d, struct privatemenu *m)
@@ -431,8 +1180,7 @@ static int menu_size_position(struct dialog *d, struct privatemenu *m)
 	 * algo 1: notext = 1 (grows vertically).
 	 * algo 2: notext = hmenu (grows horizontally, better for little term).
 	 */
-	if (set_widget_autosize(d->conf, d->rows, d->cols, &d->h, &d->w,
-	    d->text, &htext, &d->bs, hmenu, m->line + 4) != 0)
+	if (set_widget_autosize(d, &htext, hmenu, m->line + 4) != 0)
 		return (BSDDIALOG_ERROR);
 	/* avoid menurows overflow and menurows becomes "at most menurows" */
 	if (d->h - BORDERS - htext - HBUTTONS <= 2 /* menuborders */)
@@ -475,14 +1223,24 @@ static int mixedlist_redraw(struct dialog *d, struct privatemenu *m)
 	if ((int)(m->ypad + m->menurows) <= m->sel)
 		m->ypad = m->sel - m->menurows + 1;
 	/* lower pad after a terminal expansion */
-	if (m->ypad > 0 && (m->nitems - m->ypad) < (int)m->menurows)
-		m->ypad = m->nitems - m->menurows;
+	if (m->ypad > 0 && (m->nview - m->ypad) < (int)m->menurows)
+		m->ypad = MAX(m->nview - (int)m->menurows, 0);
 
 	update_box(d->conf, m->box, d->y + d->h - 5 - m->menurows, d->x + 2,
 	    m->menurows+2, d->w-4, LOWERED);
 	update_menubox(d->conf, m);
 	wnoutrefresh(m->box);
 
+	/* the pad is as big as the menu box, not as the list */
+	if (m->pad == NULL || getmaxy(m->pad) != (int)MAX(m->menurows, 1) ||
+	    getmaxx(m->pad) != (int)m->line) {
+		if (m->pad != NULL)
+			delwin(m->pad);
+		if ((m->pad = newpad(MAX(m->menurows, 1), m->line)) == NULL)
+			RETURN_ERROR("Cannot build WINDOW pad menu");
+		wbkgd(m->pad, t.dialog.color);
+	}
+
 	m->ys = d->y + d->h - 5 - m->menurows + 1;
 	m->ye = d->y + d->h - 5 ;
 	if (d->conf->menu.align_left || (int)m->line > d->w - 6) {
@@ -492,72 +1250,193 @@ static int mixedlist_redraw(struct dialog *d, struct privatemenu *m)
 		m->xs = d->x + 3 + (d->w-6)/2 - m->line/2;
 		m->xe = m->xs + d->w - 5;
 	}
-	drawseparators(d->conf, m); /* uses xe - xs */
-	pnoutrefresh(m->pad, m->ypad, 0, m->ys, m->xs, m->ye, m->xe);
+	drawitems(d->conf, m); /* separators use xe - xs */
+	pnoutrefresh(m->pad, 0, 0, m->ys, m->xs, m->ye, m->xe);
 
 	return (0);
 }
 
+/* new items could change the autosize and the width of the items */
+static int
+menu_grow(struct dialog *d, struct privatemenu *m, unsigned int line)
+{
+	int h, w, y, x;
+	unsigned int menurows;
+
+	h = d->h;
+	w = d->w;
+	y = d->y;
+	x = d->x;
+	menurows = m->menurows;
+	m->menurows = m->apimenurows;
+	if (menu_size_position(d, m) != 0)
+		return (BSDDIALOG_ERROR);
+	if (d->h == h && d->w == w && m->menurows == menurows &&
+	    m->line == line) {
+		refresh_menu(d->conf, m);
+		return (0);
+	}
+
+	/* old geometry to hide the dialog */
+	d->h = h;
+	d->w = w;
+	d->y = y;
+	d->x = x;
+
+	return (mixedlist_redraw(d, m));
+}
+
+static int update_menustream(struct dialog *d, struct privatemenu *m)
+{
+	int changed, first, item;
+	unsigned int line;
+	struct menustream *s = m->stream;
+
+	first = m->nitems;
+	line = m->line;
+	s->ticks++;
+	if ((changed = read_menustream(d->conf, m)) < 0)
+		return (BSDDIALOG_ERROR);
+	if (changed == 0) {
+		update_menubox(d->conf, m);
+		wnoutrefresh(m->box);
+		pnoutrefresh(m->pad, 0, 0, m->ys, m->xs, m->ye, m->xe);
+		return (0);
+	}
+
+	if (m->nitems > first) {
+		stream_positions(d->conf, m);
+		if (m->view != NULL) {
+			if (filter_newitems(m, first) != 0)
+				return (BSDDIALOG_ERROR);
+		} else {
+			item = FOCUSITEM(m);
+			if (s->focus >= first && s->focus < m->nitems)
+				item = s->focus;
+			set_view(m, NULL, m->nitems, item);
+		}
+	}
+
+	return (menu_grow(d, m, line));
+}
+
 static int
 do_mixedlist(struct bsddialog_conf *conf, const char *text, int rows, int cols,
     unsigned int menurows, enum menumode mode, unsigned int ngroups,
-    struct bsddialog_menugroup *groups, int *focuslist, int *focusitem)
+    struct bsddialog_menugroup *groups, struct menustream *stream,
+    int *focuslist, int *focusitem)
 {
 	bool loop, changeitem;
-	int i, next, retval;
+	int i, next, ypad, retval, item;
 	wint_t input;
+	struct privateitem *pritem;
 	struct privatemenu m;
 	struct dialog d;
 
 	if (prepare_dialog(conf, text, rows, cols, &d) != 0)
 		return (BSDDIALOG_ERROR);
 	set_buttons(&d, conf->menu.shortcut_buttons, OK_LABEL, CANCEL_LABEL);
-	if (d.conf->menu.no_name && d.conf->menu.no_desc)
-		RETURN_ERROR("Both conf.menu.no_name and conf.menu.no_desc");
-
-	if (build_privatemenu(conf, &m, mode, ngroups, groups) != 0)
-		return (BSDDIALOG_ERROR);
+	/* from now on an error goes to end, it frees the dialog */
+	retval = BSDDIALOG_ERROR;
+	m.stream = NULL;
+	m.box = m.pad = NULL;
+	m.nlevels = 0;
+	m.index = NULL;
+	if (d.conf->menu.no_name && d.conf->menu.no_desc) {
+		set_error_string("Both conf.menu.no_name and conf.menu.no_desc");
+		goto end;
+	}
 
-	if ((m.box = newwin(1, 1, 1, 1)) == NULL)
-		RETURN_ERROR("Cannot build WINDOW box menu");
+	if (stream != NULL)
+		build_streammenu(&d, &m, stream);
+	else if (build_privatemenu(&d, &m, mode, ngroups, groups) != 0)
+		goto end;
+	m.view = NULL;
+	m.nview = m.nitems;
+	m.filtermode = NOFILTER;
+	m.filter[0] = '\0';
+	m.ntopk = 0;
+	m.nindexed = -1;
+
+	if ((m.box = newwin(1, 1, 1, 1)) == NULL) {
+		set_error_string("Cannot build WINDOW box menu");
+		goto end;
+	}
 	wbkgd(m.box, t.dialog.color);
-	m.pad = newpad(m.nitems, m.line);
-	wbkgd(m.pad, t.dialog.color);
-
-	for (i = 0; i < m.nitems; i++)
-		drawitem(conf, &m, i, false);
-	m.sel = getfirst_with_default(m.nitems, m.pritems, ngroups, groups,
-	    focuslist, focusitem);
-	if (m.sel >= 0)
-		drawitem(d.conf, &m, m.sel, true);
+
+	m.sel = getfirst_with_default(&m, ngroups, groups, focuslist,
+	    focusitem);
 	m.ypad = 0;
 	m.apimenurows = menurows;
 	if (mixedlist_redraw(&d, &m) != 0)
-		return (BSDDIALOG_ERROR);
+		goto end;
 
 	changeitem = false;
 	loop = true;
 	while (loop) {
+		if (FILTERPENDING(&m))
+			timeout(0);
+		else
+			timeout(STREAMLOADING(&m) ? STREAMTIMEOUT : -1);
 		doupdate();
-		if (get_wch(&input) == ERR)
+		if ((i = get_wch(&input)) == ERR) { /* timeout */
+			if (STREAMLOADING(&m) && update_menustream(&d, &m) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
+			if (FILTERPENDING(&m)) {
+				filter_step(conf, &m);
+				refresh_menu(conf, &m);
+			}
+			continue;
+		}
+		if (m.stream != NULL)
+			m.stream->focus = -1; /* the user has the focus */
+		if (m.filtermode != NOFILTER && i != KEY_CODE_YES &&
+		    input != ' ' && iswprint(input)) {
+			if (addfilter(conf, &m, input) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
+			refresh_menu(conf, &m);
 			continue;
+		}
 		switch(input) {
 		case KEY_ENTER:
 		case 10: /* Enter */
 			retval = BUTTONVALUE(d.bs);
-			if (m.sel >= 0 && m.pritems[m.sel].type == MENUMODE)
-				m.pritems[m.sel].on = true;
+			if (m.sel >= 0 &&
+			    m.pritems[ITEM(&m, m.sel)].type == MENUMODE)
+				m.pritems[ITEM(&m, m.sel)].on = true;
 			loop = false;
 			break;
 		case 27: /* Esc */
 			if (conf->key.enable_esc) {
 				retval = BSDDIALOG_ESC;
 				if (m.sel >= 0 &&
-				   m.pritems[m.sel].type == MENUMODE)
-					m.pritems[m.sel].on = true;
+				   m.pritems[ITEM(&m, m.sel)].type == MENUMODE)
+					m.pritems[ITEM(&m, m.sel)].on = true;
 				loop = false;
 			}
 			break;
+		case KEY_CTRL('f'): /* off, substring, fuzzy */
+			clearfilter(&m);
+			if (m.filtermode == NOFILTER)
+				m.filtermode = SUBSTRFILTER;
+			else if (m.filtermode == SUBSTRFILTER)
+				m.filtermode = FUZZYFILTER;
+			else
+				m.filtermode = NOFILTER;
+			refresh_menu(conf, &m);
+			continue;
+		case KEY_BACKSPACE:
+		case 8:
+		case 127:
+			if (m.filtermode == NOFILTER)
+				break;
+			delfilter(conf, &m);
+			refresh_menu(conf, &m);
+			continue;
 		case '\t': /* TAB */
 		case KEY_RIGHT:
 			d.bs.curr = (d.bs.curr + 1) % d.bs.nbuttons;
@@ -573,15 +1452,21 @@ do_mixedlist(struct bsddialog_conf *conf, const char *text, int rows, int cols,
 			if (conf->key.f1_file == NULL &&
 			    conf->key.f1_message == NULL)
 				break;
-			if (f1help_dialog(conf) != 0)
-				return (BSDDIALOG_ERROR);
-			if (mixedlist_redraw(&d, &m) != 0)
-				return (BSDDIALOG_ERROR);
+			if (f1help_dialog(conf) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
+			if (mixedlist_redraw(&d, &m) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		case KEY_CTRL('l'):
 		case KEY_RESIZE:
-			if (mixedlist_redraw(&d, &m) != 0)
-				return (BSDDIALOG_ERROR);
+			if (mixedlist_redraw(&d, &m) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		}
 
@@ -589,54 +1474,52 @@ do_mixedlist(struct bsddialog_conf *conf, const char *text, int rows, int cols,
 			continue;
 		switch(input) {
 		case KEY_HOME:
-			next = getnext(m.nitems, m.pritems, -1);
+			next = getnext(&m, -1);
 			changeitem = next != m.sel;
 			break;
 		case '-':
 		case KEY_CTRL('p'):
 		case KEY_UP:
-			next = getprev(m.pritems, m.sel);
+			next = getprev(&m, m.sel);
 			changeitem = next != m.sel;
 			break;
 		case KEY_PPAGE:
-			next = getfastprev(m.menurows, m.pritems, m.sel);
+			next = getfastprev(&m, m.sel);
 			changeitem = next != m.sel;
 			break;
 		case KEY_END:
-			next = getprev(m.pritems, m.nitems);
+			next = getprev(&m, m.nview);
 			changeitem = next != m.sel;
 			break;
 		case '+':
 		case KEY_CTRL('n'):
 		case KEY_DOWN:
-			next = getnext(m.nitems, m.pritems, m.sel);
+			next = getnext(&m, m.sel);
 			changeitem = next != m.sel;
 			break;
 		case KEY_NPAGE:
-			next = getfastnext(m.menurows, m.nitems, m.pritems, m.sel);
+			next = getfastnext(&m, m.sel);
 			changeitem = next != m.sel;
 			break;
 		case ' ': /* Space */
-			if (m.pritems[m.sel].type == MENUMODE) {
+			item = ITEM(&m, m.sel);
+			pritem = &m.pritems[item];
+			if (pritem->type == MENUMODE) {
 				retval = BUTTONVALUE(d.bs);
-				m.pritems[m.sel].on = true;
+				pritem->on = true;
 				loop = false;
-			} else if (m.pritems[m.sel].type == CHECKLISTMODE) {
-				m.pritems[m.sel].on = !m.pritems[m.sel].on;
+			} else if (pritem->type == CHECKLISTMODE) {
+				pritem->on = !pritem->on;
 			} else { /* RADIOLISTMODE */
-				for (i = m.sel - m.pritems[m.sel].index;
-				    i < m.nitems &&
-				    m.pritems[i].group == m.pritems[m.sel].group;
-				    i++) {
-					if (i != m.sel && m.pritems[i].on) {
+				for (i = item - pritem->index; i < m.nitems &&
+				    m.pritems[i].group == pritem->group; i++) {
+					if (i != item && m.pritems[i].on)
 						m.pritems[i].on = false;
-						drawitem(conf, &m, i, false);
-					}
 				}
-				m.pritems[m.sel].on = !m.pritems[m.sel].on;
+				pritem->on = !pritem->on;
 			}
-			drawitem(conf, &m, m.sel, true);
-			pnoutrefresh(m.pad, m.ypad, 0, m.ys, m.xs, m.ye, m.xe);
+			drawitems(conf, &m);
+			pnoutrefresh(m.pad, 0, 0, m.ys, m.xs, m.ye, m.xe);
 			break;
 		default:
 			if (conf->menu.shortcut_buttons) {
@@ -644,49 +1527,64 @@ do_mixedlist(struct bsddialog_conf *conf, const char *text, int rows, int cols,
 					DRAW_BUTTONS(d);
 					doupdate();
 					retval = BUTTONVALUE(d.bs);
-					if (m.pritems[m.sel].type == MENUMODE)
-						m.pritems[m.sel].on = true;
+					pritem = &m.pritems[ITEM(&m, m.sel)];
+					if (pritem->type == MENUMODE)
+						pritem->on = true;
 					loop = false;
 				}
 				break;
 			}
 
 			/* shourtcut items */
-			next = getnextshortcut(m.nitems, m.pritems, m.sel,
-			    input);
+			next = getnextshortcut(&m, m.sel, input);
 			changeitem = next != m.sel;
 		} /* end switch get_wch() */
 
 		if (changeitem) {
-			drawitem(conf, &m, m.sel, false);
-			m.sel = next;
-			drawitem(conf, &m, m.sel, true);
-			if (m.ypad > m.sel && m.ypad > 0)
-				m.ypad = m.sel;
-			if ((int)(m.ypad + m.menurows) <= m.sel)
-				m.ypad = m.sel - m.menurows + 1;
+			ypad = m.ypad;
+			if (m.ypad > next && m.ypad > 0)
+				m.ypad = next;
+			if ((int)(m.ypad + m.menurows) <= next)
+				m.ypad = next - m.menurows + 1;
+			if (m.ypad != ypad) {
+				m.sel = next;
+				drawitems(conf, &m);
+			} else {
+				drawitem(conf, &m, m.sel, false);
+				m.sel = next;
+				drawitem(conf, &m, m.sel, true);
+			}
 			update_menubox(conf, &m);
 			wnoutrefresh(m.box);
-			pnoutrefresh(m.pad, m.ypad, 0, m.ys, m.xs, m.ye, m.xe);
+			pnoutrefresh(m.pad, 0, 0, m.ys, m.xs, m.ye, m.xe);
 			changeitem = false;
 		}
 	} /* end while (loop) */
 
-	set_return_on(&m, groups);
+	if (m.stream == NULL)
+		set_return_on(&m, groups);
 
 	if (focuslist != NULL)
-		*focuslist = m.sel < 0 ? -1 : m.pritems[m.sel].group;
+		*focuslist = m.sel < 0 ? -1 : m.pritems[ITEM(&m, m.sel)].group;
 	if (focusitem !=NULL)
-		*focusitem = m.sel < 0 ? -1 : m.pritems[m.sel].index;
+		*focusitem = m.sel < 0 ? -1 : m.pritems[ITEM(&m, m.sel)].index;
 
 	if (m.hasbottomdesc && conf->clear) {
 		move(SCREENLINES - 1, 2);
 		clrtoeol();
 	}
+end:
+	timeout(-1);
+	/* the stream items are freed also on error, without a name */
+	if (m.stream != NULL)
+		close_menustream(&m,
+		    retval == BSDDIALOG_ERROR ? -1 : FOCUSITEM(&m));
+	while (m.nlevels > 0)
+		freelevel(&m.levels[--m.nlevels]);
+	free(m.index);
 	delwin(m.pad);
 	delwin(m.box);
 	end_dialog(&d);
-	free(m.pritems);
 
 	return (retval);
 }
@@ -700,7 +1598,7 @@ bsddialog_mixedlist(struct bsddialog_conf *conf, const char *text, int rows,
 	int retval;
 
 	retval = do_mixedlist(conf, text, rows, cols, menurows, MIXEDLISTMODE,
-	    ngroups, groups, focuslist, focusitem);
+	    ngroups, groups, NULL, focuslist, focusitem);
 
 	return (retval);
 }
@@ -716,7 +1614,7 @@ bsddialog_checklist(struct bsddialog_conf *conf, const char *text, int rows,
 
 	CHECK_ARRAY(nitems, items); /* efficiency, avoid do_mixedlist() */
 	retval = do_mixedlist(conf, text, rows, cols, menurows, CHECKLISTMODE,
-	    1, &group, &focuslist, focusitem);
+	    1, &group, NULL, &focuslist, focusitem);
 
 	return (retval);
 }
@@ -732,7 +1630,27 @@ bsddialog_menu(struct bsddialog_conf *conf, const char *text, int rows,
 
 	CHECK_ARRAY(nitems, items); /* efficiency, avoid do_mixedlist() */
 	retval = do_mixedlist(conf, text, rows, cols, menurows, MENUMODE, 1,
-	    &group, &focuslist, focusitem);
+	    &group, NULL, &focuslist, focusitem);
+
+	return (retval);
+}
+
+int
+bsddialog_menu_fd(struct bsddialog_conf *conf, const char *text, int rows,
+    int cols, unsigned int menurows, int fd, int *focusitem, char **name)
+{
+	int retval, focuslist = 0;
+	struct menustream stream;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.fd = fd;
+	stream.focus = (focusitem != NULL) ? *focusitem : -1;
+	retval = do_mixedlist(conf, text, rows, cols, menurows, MENUMODE, 0,
+	    NULL, &stream, &focuslist, focusitem);
+	if (name != NULL)
+		*name = stream.name;
+	else
+		free(stream.name);
 
 	return (retval);
 }
@@ -748,7 +1666,7 @@ bsddialog_radiolist(struct bsddialog_conf *conf, const char *text, int rows,
 
 	CHECK_ARRAY(nitems, items); /* efficiency, avoid do_mixedlist() */
 	retval = do_mixedlist(conf, text, rows, cols, menurows, RADIOLISTMODE,
-	    1, &group, &focuslist, focusitem);
+	    1, &group, NULL, &focuslist, focusitem);
 
 	return (retval);
 }
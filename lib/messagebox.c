@@ -57,8 +57,7 @@ static int message_size_position(struct dialog *d, int *htext)
 
 	if (set_widget_size(d->conf, d->rows, d->cols, &d->h, &d->w) != 0)
 		return (BSDDIALOG_ERROR);
-	if (set_widget_autosize(d->conf, d->rows, d->cols, &d->h, &d->w,
-	    d->text, (*htext < 0) ? htext : NULL, &d->bs, 0, 0) != 0)
+	if (set_widget_autosize(d, (*htext < 0) ? htext : NULL, 0, 0) != 0)
 		return (BSDDIALOG_ERROR);
 	minw = (*htext > 0) ? 1 + TEXTHMARGINS : 0 ;
 	if (widget_checksize(d->h, d->w, &d->bs, MIN(*htext, 1), minw) != 0)
@@ -71,8 +70,6 @@ static int message_size_position(struct dialog *d, int *htext)
 
 static int message_draw(struct dialog *d, struct scroll *s)
 {
-	int unused;
-
 	if (d->built) {
 		hide_dialog(d);
 		refresh(); /* Important for decreasing screen */
@@ -86,8 +83,7 @@ static int message_draw(struct dialog *d, struct scroll *s)
 
 	s->printrows = d->h - BORDER - HBUTTONS - BORDER;
 	s->ypad = 0;
-	getmaxyx(d->textpad, s->htextpad, unused);
-	(void)unused; /* fix unused error */
+	s->htextpad = d->textrows;
 
 	return (0);
 }
@@ -105,9 +101,10 @@ do_message(struct bsddialog_conf *conf, const char *text, int rows, int cols,
 	if (prepare_dialog(conf, text, rows, cols, &d) != 0)
 		return (BSDDIALOG_ERROR);
 	set_buttons(&d, true, oklabel, cancellabel);
+	retval = BSDDIALOG_ERROR;
 	s.htext = -1;
 	if (message_draw(&d, &s) != 0)
-		return (BSDDIALOG_ERROR);
+		goto end;
 
 	loop = true;
 	while (loop) {
@@ -168,15 +165,18 @@ do_message(struct bsddialog_conf *conf, const char *text, int rows, int cols,
 			if (d.conf->key.f1_file == NULL &&
 			    d.conf->key.f1_message == NULL)
 				break;
-			if (f1help_dialog(d.conf) != 0)
-				return (BSDDIALOG_ERROR);
-			if (message_draw(&d, &s) != 0)
-				return (BSDDIALOG_ERROR);
+			if (f1help_dialog(d.conf) != 0 ||
+			    message_draw(&d, &s) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		case KEY_CTRL('l'):
 		case KEY_RESIZE:
-			if (message_draw(&d, &s) != 0)
-				return (BSDDIALOG_ERROR);
+			if (message_draw(&d, &s) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		default:
 			if (shortcut_buttons(input, &d.bs)) {
@@ -188,6 +188,7 @@ do_message(struct bsddialog_conf *conf, const char *text, int rows, int cols,
 		}
 	}
 
+end:
 	end_dialog(&d);
 
 	return (retval);
@@ -212,20 +213,23 @@ int
 bsddialog_infobox(struct bsddialog_conf *conf, const char *text, int rows,
     int cols)
 {
-	int htext;
+	int htext, retval;
 	struct dialog d;
 
 	if (prepare_dialog(conf, text, rows, cols, &d) != 0)
 		return (BSDDIALOG_ERROR);
+	retval = BSDDIALOG_ERROR;
 	htext = -1;
 	if (message_size_position(&d, &htext) != 0)
-		return (BSDDIALOG_ERROR);
+		goto end;
 	if (draw_dialog(&d) != 0)
-		return (BSDDIALOG_ERROR);
+		goto end;
 	TEXTPAD(&d, 0);
 	doupdate();
+	retval = BSDDIALOG_OK;
 
+end:
 	end_dialog(&d);
 
-	return (BSDDIALOG_OK);
+	return (retval);
 }
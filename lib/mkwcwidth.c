@@ -0,0 +1,230 @@
+/*-
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Copyright (c) 2021-2024 Alfonso Sabato Siciliano
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Generator of wcwidth.c, not part of the library:
+ *	cc -o mkwcwidth mkwcwidth.c
+ *	./mkwcwidth UnicodeData.txt EastAsianWidth.txt > wcwidth.c
+ * The files are the ones of the Unicode Character Database, the Unicode
+ * version is read from the header of EastAsianWidth.txt.
+ *
+ * Widths: 0 for nonspacing and enclosing marks, format characters (not the
+ * prepended concatenation marks), Hangul medial vowels and final consonants,
+ * NUL; 2 for East Asian Wide and Fullwidth, also the unassigned ones of the
+ * wide blocks; nonprintable for controls, line and paragraph separators,
+ * surrogates and unassigned; 1 otherwise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NCODES      0x110000
+#define BLOCKSHIFT  8
+#define BLOCKLEN    (1 << BLOCKSHIFT)
+#define NBLOCKS     (NCODES >> BLOCKSHIFT)
+#define NONPRINT    3
+#define LINELEN     1024
+
+static unsigned char widths[NCODES];
+static unsigned char assigned[NCODES];
+static int blockof[NBLOCKS];
+static int uniq[NBLOCKS];
+static char version[64];
+
+static int gc_width(int c, const char *gc)
+{
+	if (c == 0)
+		return (0);
+	if (c == 0x00ad) /* SOFT HYPHEN is printed */
+		return (1);
+	/* Prepended_Concatenation_Mark of PropList.txt, format but printed */
+	if ((c >= 0x0600 && c <= 0x0605) || c == 0x06dd || c == 0x070f ||
+	    c == 0x0890 || c == 0x0891 || c == 0x08e2 || c == 0x110bd ||
+	    c == 0x110cd)
+		return (1);
+	if ((c >= 0x1160 && c <= 0x11ff) || (c >= 0xd7b0 && c <= 0xd7ff))
+		return (0); /* Hangul Jamo, combined with the leading */
+	if (strcmp(gc, "Cc") == 0 || strcmp(gc, "Cs") == 0 ||
+	    strcmp(gc, "Zl") == 0 || strcmp(gc, "Zp") == 0)
+		return (NONPRINT);
+	if (strcmp(gc, "Mn") == 0 || strcmp(gc, "Me") == 0 ||
+	    strcmp(gc, "Cf") == 0)
+		return (0);
+
+	return (1);
+}
+
+/* code;name;general category;... "<X, First>" and "<X, Last>" for ranges */
+static int read_unicodedata(const char *path)
+{
+	int c, first;
+	char line[LINELEN], *name, *gc;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		perror(path);
+		return (1);
+	}
+	first = -1;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		c = (int)strtol(line, &name, 16);
+		if (*name != ';' || c < 0 || c >= NCODES)
+			continue;
+		name++;
+		if ((gc = strchr(name, ';')) == NULL)
+			continue;
+		*gc++ = '\0';
+		gc[strcspn(gc, ";")] = '\0';
+		if (strstr(name, ", First>") != NULL) {
+			first = c;
+			continue;
+		}
+		if (strstr(name, ", Last>") == NULL || first < 0)
+			first = c;
+		for (; first <= c; first++) {
+			widths[first] = gc_width(first, gc);
+			assigned[first] = 1;
+		}
+		first = -1;
+	}
+	fclose(fp);
+
+	return (0);
+}
+
+/* first[..last];property # comment, the version is in the first comment */
+static int read_eastasianwidth(const char *path)
+{
+	int c, first, last;
+	char line[LINELEN], *p, *end;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL) {
+		perror(path);
+		return (1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (version[0] == '\0' &&
+		    (p = strstr(line, "EastAsianWidth-")) != NULL) {
+			p += strlen("EastAsianWidth-");
+			end = strstr(p, ".txt");
+			if (end != NULL && end - p < (int)sizeof(version)) {
+				memcpy(version, p, end - p);
+				version[end - p] = '\0';
+			}
+		}
+		first = last = (int)strtol(line, &p, 16);
+		if (p == line)
+			continue;
+		if (strncmp(p, "..", 2) == 0)
+			last = (int)strtol(p + 2, &p, 16);
+		p += strspn(p, " \t");
+		if (*p != ';')
+			continue;
+		p++;
+		p += strspn(p, " \t");
+		if (*p != 'W' && *p != 'F')
+			continue;
+		if (p[1] != ' ' && p[1] != '\t' && p[1] != '#' && p[1] != '\n')
+			continue;
+		for (c = first; c <= last && c < NCODES; c++) {
+			if (assigned[c] == 0 || widths[c] == 1)
+				widths[c] = 2;
+		}
+	}
+	fclose(fp);
+
+	if (version[0] == '\0') {
+		fprintf(stderr, "mkwcwidth: no version in %s\n", path);
+		return (1);
+	}
+
+	return (0);
+}
+
+int main(int argc, char *argv[])
+{
+	int c, b, u, nuniq, i, byte;
+
+	if (argc != 3) {
+		fprintf(stderr,
+		    "usage: mkwcwidth UnicodeData.txt EastAsianWidth.txt\n");
+		return (1);
+	}
+
+	memset(widths, NONPRINT, sizeof(widths));
+	if (read_unicodedata(argv[1]) != 0)
+		return (1);
+	if (read_eastasianwidth(argv[2]) != 0)
+		return (1);
+
+	nuniq = 0;
+	for (b = 0; b < NBLOCKS; b++) {
+		for (u = 0; u < nuniq; u++) {
+			if (memcmp(widths + uniq[u] * BLOCKLEN,
+			    widths + b * BLOCKLEN, BLOCKLEN) == 0)
+				break;
+		}
+		if (u == nuniq)
+			uniq[nuniq++] = b;
+		blockof[b] = u;
+	}
+	if (nuniq > 256) {
+		fprintf(stderr, "mkwcwidth: %d blocks, more than 256\n", nuniq);
+		return (1);
+	}
+
+	printf("/* Generated by mkwcwidth.c from Unicode %s, do not edit. */\n\n",
+	    version);
+	printf("#include <curses.h>\n\n");
+	printf("#include \"bsddialog.h\"\n");
+	printf("#include \"lib_util.h\"\n\n");
+	printf("/* block of code point >> %d */\n", BLOCKSHIFT);
+	printf("const unsigned char wcwidth_index[%d] = {", NBLOCKS);
+	for (b = 0; b < NBLOCKS; b++)
+		printf("%s%3d,", (b % 12 == 0) ? "\n\t" : " ", blockof[b]);
+	printf("\n};\n\n");
+
+	printf("/* 2 bits for code point: 0, 1, 2 columns, 3 nonprintable */\n");
+	printf("const unsigned char wcwidth_blocks[%d][%d] = {\n", nuniq,
+	    BLOCKLEN / 4);
+	for (u = 0; u < nuniq; u++) {
+		printf("\t{");
+		for (i = 0; i < BLOCKLEN / 4; i++) {
+			c = uniq[u] * BLOCKLEN + i * 4;
+			byte = widths[c] | widths[c + 1] << 2 |
+			    widths[c + 2] << 4 | widths[c + 3] << 6;
+			printf("%s0x%02x,", (i % 10 == 0) ? "\n\t    " : " ",
+			    byte);
+		}
+		printf("\n\t},\n");
+	}
+	printf("};\n");
+
+	return (0);
+}
@@ -25,30 +25,1189 @@
  * SUCH DAMAGE.
  */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <curses.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wctype.h>
 
 #include "bsddialog.h"
 #include "bsddialog_theme.h"
 #include "lib_util.h"
 
+#define FOLLOWTIMEOUT   500  /* ms, conf.textbox.follow */
+#define STREAMTIMEOUT   100  /* ms, bsddialog_textbox_fd() */
+#define STREAMMAXREAD   (1024 * 1024) /* bytes for each timeout */
+#define RINGLINES       1024 /* default conf.textbox.ringlines */
+#define SPILLINDEXBUF   1024 /* line offsets to write together */
+#define HEXROWBYTES     16
+#define HEXROWLEN       (16 + 2 + HEXROWBYTES * 4 + 2) /* offset, hex, ascii */
+#define INDEXMAGIC      "BSDDIX01"
+#define SEARCHMAX       256  /* pattern bytes */
+#define SEARCHCHUNK     (4 * 1024 * 1024) /* file bytes for each tick */
+#define SEARCHLINES     4096 /* stream lines for each tick */
+#define ROUNDUP8(n)     (((n) + 7) & ~7)
+
+/*
+ * Stream from a file descriptor, memory does not depend on the input size:
+ * data is appended to a temporary spill file, the offsets of the lines are
+ * appended to a temporary spill index and only the last conf.textbox.ringlines
+ * complete lines are kept in memory. Older lines are read from the spill file.
+ */
+struct ringline {
+	char *str;
+	size_t len;
+};
+
+struct stream {
+	int fd;              /* producer, -1 at EOF */
+	FILE *spill;         /* data */
+	off_t spillsize;
+	FILE *spillindex;    /* off_t of each line */
+	off_t *indexbuf;     /* offsets not written to spillindex yet */
+	int nindexbuf;
+	int nindexflushed;
+	unsigned int ringlines;
+	struct ringline *ring;
+	int ncomplete;       /* lines ended by a newline */
+	bool incomplete;     /* the last line does not end with a newline */
+	char *cur;           /* the current incomplete line */
+	size_t curlen;
+	size_t cursize;
+	char *buf;           /* to read an old line from spill */
+	size_t bufsize;
+};
+
+/*
+ * conf.textbox.cachedir: the index of a mapped file is saved in the file
+ * <cachedir>/<hash of the real path>.idx and mapped by a later open if path,
+ * device, inode, size and mtime are unchanged. The header is followed by the
+ * path and by the offsets aligned to size_t.
+ */
+struct indexcache {
+	char magic[8];
+	uint32_t offsize;
+	uint32_t pathlen;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime;
+	int64_t mtimensec;
+	uint64_t nlines;
+};
+
+/*
+ * Search: the lines with a match are collected in order, a chunk for each
+ * tick of the key loop while the user does not type, or until the next
+ * match is found if the user asks for it before.
+ */
+struct search {
+	char pattern[SEARCHMAX];
+	size_t len;    /* 0 without search */
+	bool forward;
+	bool notfound;
+	int *matches;  /* lines with a match, ascending */
+	int nmatches;
+	int maxmatches;
+	int scanned;   /* lines from 0 already searched */
+	int cur;       /* last found line */
+	int ypad;      /* ypad after the last jump */
+};
+
+/*
+ * The file is mapped in memory and not loaded in a pad: an index of the line
+ * offsets is built and only the visible slice of the visible lines is printed
+ * in a pad with the size of the text area.
+ */
 struct scrolltext {
 	WINDOW *pad;
-	int ypad;
-	int xpad;
+	int ypad;      /* first visible line */
+	int yrow;      /* wrap mode: first visible row of the ypad line */
+	int xpad;      /* first visible column */
 	int ys;
 	int ye;
 	int xs;
 	int xe;
-	int hpad;
-	int wpad;
-	int margin;    /* 2 with multicolumn char, 0 otherwise */
+	int hpad;      /* virtual pad: lines, at least 1 */
+	int wpad;      /* virtual pad: cols of the longest printed line */
+	unsigned char *measured; /* a bit for each line already in wpad */
+	int nmeasured; /* lines of measured, multiple of 8 */
 	int printrows; /* d.h - BORDERS - HBUTTONS */
+	int lastline;  /* last visible line */
+	int tablen;
+	/* wrap mode */
+	bool wrap;
+	int wrapwidth;
+	int *wraprows; /* rows of each line with wrapwidth, 0 not computed */
+	int nwraprows;
+	/* file */
+	int fd;        /* open only to follow a regular file */
+	char *data;    /* mmap() or read(), pread() to follow */
+	size_t size;
+	size_t maxsize; /* allocated data of a followed file */
+	bool mapped;
+	struct stat sb;
+	/* lines index */
+	int nlines;
+	int maxlines;
+	size_t *lines; /* offset of each line in data */
+	void *cachemap; /* lines from conf.textbox.cachedir, NULL otherwise */
+	size_t cachemapsize;
+	/* conf.textbox.hex, a line is a row of HEXROWBYTES, no index */
+	bool hex;
+	int hexdigits;
+	char hexrow[HEXROWLEN + 1];
+	/* bsddialog_textbox_fd(), NULL for a file */
+	struct stream *stream;
+	struct search search;
 };
 
+#define SEARCHING(st)                                                           \
+	((st)->search.len > 0 && (st)->search.scanned < (st)->nlines)
+
+static int map_file(struct scrolltext *st, size_t size)
+{
+	if (st->mapped)
+		munmap(st->data, st->size);
+	st->data = NULL;
+	st->size = 0;
+	st->mapped = false;
+	if (size == 0)
+		return (0);
+
+	st->data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, st->fd, 0);
+	if (st->data == MAP_FAILED) {
+		st->data = NULL;
+		return (BSDDIALOG_ERROR);
+	}
+	st->size = size;
+	st->mapped = true;
+
+	return (0);
+}
+
+/* data of a followed file from offset from to size, short if truncated */
+static int pread_file(struct scrolltext *st, size_t from, size_t size)
+{
+	size_t maxsize;
+	ssize_t n;
+	char *data;
+
+	if (size > st->maxsize) {
+		maxsize = MAX(size, st->maxsize * 2);
+		if ((data = realloc(st->data, maxsize)) == NULL)
+			RETURN_ERROR("Cannot allocate memory to follow file");
+		st->data = data;
+		st->maxsize = maxsize;
+	}
+	st->size = from;
+	while (st->size < size) {
+		n = pread(st->fd, st->data + st->size, size - st->size,
+		    st->size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			RETURN_ERROR("Cannot read the file to follow");
+		if (n == 0)
+			break;
+		st->size += n;
+	}
+
+	return (0);
+}
+
+/* on error fd and data are left to close_file() */
+static int read_file(struct scrolltext *st, const char *file, bool follow)
+{
+	size_t bufsize;
+	ssize_t n;
+	char *data;
+	struct stat sb;
+
+	st->data = NULL;
+	st->size = st->maxsize = 0;
+	st->mapped = false;
+	if ((st->fd = open(file, O_RDONLY)) < 0)
+		RETURN_FMTERROR("Cannot open file \"%s\"", file);
+	if (fstat(st->fd, &sb) != 0)
+		RETURN_FMTERROR("Cannot stat file \"%s\"", file);
+	st->sb = sb;
+
+	/* a followed file is copied, a truncated mapping would fault */
+	if (S_ISREG(sb.st_mode) && follow)
+		return (pread_file(st, 0, sb.st_size));
+	if (S_ISREG(sb.st_mode) && map_file(st, sb.st_size) == 0 &&
+	    st->mapped) {
+		close(st->fd);
+		st->fd = -1;
+		return (0);
+	}
+
+	/* not mappable, for example a special file */
+	bufsize = 0;
+	while (true) {
+		if (st->size == bufsize) {
+			bufsize = (bufsize == 0) ? BUFSIZ : bufsize * 2;
+			if ((data = realloc(st->data, bufsize)) == NULL)
+				RETURN_ERROR("Cannot allocate memory to read "
+				    "textbox file");
+			st->data = data;
+		}
+		n = read(st->fd, st->data + st->size, bufsize - st->size);
+		if (n <= 0)
+			break;
+		st->size += n;
+	}
+	close(st->fd);
+	st->fd = -1;
+	if (n < 0)
+		RETURN_FMTERROR("Cannot read file \"%s\"", file);
+
+	return (0);
+}
+
+/*
+ * Index the lines of data from offset "from", a line starts at offset 0 or
+ * after a newline. memchr() is vectorized by libc, one call for each line.
+ */
+static int index_lines(struct scrolltext *st, size_t from)
+{
+	int maxlines;
+	const char *p, *end, *nl;
+	size_t rows, *lines;
+
+	if (st->hex) {
+		rows = (st->size + HEXROWBYTES - 1) / HEXROWBYTES;
+		st->nlines = MIN(rows, INT_MAX);
+		st->hpad = MAX(st->nlines, 1);
+		for (st->hexdigits = 8; st->hexdigits < 16 &&
+		    (st->size >> (st->hexdigits * 4)) > 0; st->hexdigits++)
+			;
+		return (0);
+	}
+
+	p = st->data + from;
+	end = st->data + st->size;
+	while (p < end) {
+		if (p == st->data || p[-1] == '\n') {
+			if (st->nlines >= st->maxlines) {
+				maxlines = (st->maxlines == 0) ? 1024 :
+				    st->maxlines * 2;
+				lines = realloc(st->lines,
+				    maxlines * sizeof(size_t));
+				if (lines == NULL)
+					RETURN_ERROR("Cannot allocate textbox "
+					    "index");
+				st->lines = lines;
+				st->maxlines = maxlines;
+			}
+			st->lines[st->nlines] = p - st->data;
+			st->nlines++;
+		}
+		if ((nl = memchr(p, '\n', end - p)) == NULL)
+			break;
+		p = nl + 1;
+	}
+	st->hpad = MAX(st->nlines, 1);
+
+	return (0);
+}
+
+/*
+ * Follow mode: only new bytes are indexed, a truncated file is indexed again.
+ * Returns 1 if the file is grown, 2 if it is truncated.
+ */
+static int follow_file(struct scrolltext *st)
+{
+	bool truncated;
+	size_t oldsize;
+	struct stat sb;
+
+	if (st->fd < 0)
+		return (0);
+	if (fstat(st->fd, &sb) != 0)
+		RETURN_ERROR("Cannot stat the file to follow");
+	if ((size_t)sb.st_size == st->size)
+		return (0);
+
+	oldsize = st->size;
+	truncated = (size_t)sb.st_size < oldsize;
+	if (pread_file(st, truncated ? 0 : oldsize, sb.st_size) != 0)
+		return (BSDDIALOG_ERROR);
+	if (truncated) {
+		st->nlines = 0;
+		if (index_lines(st, 0) != 0)
+			return (BSDDIALOG_ERROR);
+		return (2);
+	}
+	if (index_lines(st, oldsize) != 0)
+		return (BSDDIALOG_ERROR);
+
+	return (1);
+}
+
+static void
+set_indexcache(struct scrolltext *st, const char *realfile, struct indexcache *h)
+{
+	memset(h, 0, sizeof(struct indexcache));
+	memcpy(h->magic, INDEXMAGIC, sizeof(h->magic));
+	h->offsize = sizeof(size_t);
+	h->pathlen = strlen(realfile);
+	h->dev = st->sb.st_dev;
+	h->ino = st->sb.st_ino;
+	h->size = st->sb.st_size;
+	h->mtime = st->sb.st_mtim.tv_sec;
+	h->mtimensec = st->sb.st_mtim.tv_nsec;
+	h->nlines = st->nlines;
+}
+
+/* a stale or corrupt cache could have offsets out of data */
+static int check_index(struct scrolltext *st, size_t *lines, size_t nlines)
+{
+	size_t i;
+
+	if (lines[0] != 0)
+		return (1);
+	for (i = 1; i < nlines; i++)
+		if (lines[i] <= lines[i - 1] || lines[i] >= st->size)
+			return (1);
+
+	return (0);
+}
+
+/* 0 if the lines are mapped from the cache */
+static int
+load_index(struct scrolltext *st, const char *realfile, const char *cachefile)
+{
+	int fd;
+	char *path;
+	size_t start, *lines;
+	void *map;
+	struct stat sb;
+	struct indexcache h, cached;
+
+	if ((fd = open(cachefile, O_RDONLY)) < 0)
+		return (1);
+	map = MAP_FAILED;
+	if (fstat(fd, &sb) != 0 || read(fd, &cached, sizeof(cached)) !=
+	    (ssize_t)sizeof(cached))
+		goto end;
+	set_indexcache(st, realfile, &h);
+	h.nlines = cached.nlines;
+	start = sizeof(h) + h.pathlen;
+	start = (start + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+	if (memcmp(&h, &cached, sizeof(h)) != 0 || h.nlines == 0 ||
+	    h.nlines > INT_MAX ||
+	    (size_t)sb.st_size != start + h.nlines * sizeof(size_t))
+		goto end;
+	map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto end;
+	path = (char *)map + sizeof(h);
+	lines = (size_t *)((char *)map + start);
+	if (memcmp(path, realfile, h.pathlen) != 0 ||
+	    check_index(st, lines, h.nlines) != 0) {
+		munmap(map, sb.st_size);
+		map = MAP_FAILED;
+		goto end;
+	}
+
+	st->cachemap = map;
+	st->cachemapsize = sb.st_size;
+	st->lines = lines;
+	st->nlines = st->maxlines = h.nlines;
+	st->hpad = st->nlines;
+end:
+	close(fd);
+
+	return (map == MAP_FAILED ? 1 : 0);
+}
+
+/* the cache is an optimization, errors are ignored */
+static void
+save_index(struct scrolltext *st, const char *realfile, const char *cachefile)
+{
+	int fd;
+	char tmpfile[PATH_MAX];
+	size_t len, start;
+	FILE *fp;
+	struct indexcache h;
+
+	if (st->nlines == 0)
+		return;
+	if (snprintf(tmpfile, sizeof(tmpfile), "%s.XXXXXX", cachefile) >=
+	    (int)sizeof(tmpfile) || (fd = mkstemp(tmpfile)) < 0)
+		return;
+	if ((fp = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		unlink(tmpfile);
+		return;
+	}
+
+	set_indexcache(st, realfile, &h);
+	len = sizeof(h) + h.pathlen;
+	start = (len + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+	if (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+	    fwrite(realfile, 1, h.pathlen, fp) != h.pathlen ||
+	    fwrite("\0\0\0\0\0\0\0\0", 1, start - len, fp) != start - len ||
+	    fwrite(st->lines, sizeof(size_t), st->nlines, fp) !=
+	    (size_t)st->nlines) {
+		fclose(fp);
+		unlink(tmpfile);
+		return;
+	}
+	if (fclose(fp) != 0 || rename(tmpfile, cachefile) != 0)
+		unlink(tmpfile);
+}
+
+/* the index of a mapped and not followed file could be cached */
+static int index_file(struct scrolltext *st, const char *cachedir,
+    const char *file)
+{
+	bool cache;
+	char realfile[PATH_MAX], cachefile[PATH_MAX];
+	const char *p;
+	uint64_t hash;
+
+	cache = cachedir != NULL && st->mapped && st->fd < 0 && !st->hex &&
+	    realpath(file, realfile) != NULL;
+	if (cache) {
+		hash = 0xcbf29ce484222325ULL; /* FNV-1a */
+		for (p = realfile; *p != '\0'; p++) {
+			hash ^= (unsigned char)*p;
+			hash *= 0x100000001b3ULL;
+		}
+		if (snprintf(cachefile, sizeof(cachefile), "%s/%016" PRIx64
+		    ".idx", cachedir, hash) >= (int)sizeof(cachefile))
+			cache = false;
+	}
+
+	if (cache && load_index(st, realfile, cachefile) == 0)
+		return (0);
+	if (index_lines(st, 0) != 0)
+		return (BSDDIALOG_ERROR);
+	if (cache)
+		save_index(st, realfile, cachefile);
+
+	return (0);
+}
+
+static void close_stream(struct stream *s)
+{
+	unsigned int i;
+
+	if (s->spill != NULL)
+		fclose(s->spill);
+	if (s->spillindex != NULL)
+		fclose(s->spillindex);
+	if (s->ring != NULL) {
+		for (i = 0; i < s->ringlines; i++)
+			free(s->ring[i].str);
+		free(s->ring);
+	}
+	free(s->indexbuf);
+	free(s->cur);
+	free(s->buf);
+	free(s);
+}
+
+static void close_file(struct scrolltext *st)
+{
+	if (st->stream != NULL)
+		close_stream(st->stream);
+	if (st->mapped)
+		munmap(st->data, st->size);
+	else
+		free(st->data);
+	if (st->fd >= 0)
+		close(st->fd);
+	if (st->cachemap != NULL)
+		munmap(st->cachemap, st->cachemapsize);
+	else
+		free(st->lines);
+}
+
+static int open_stream(struct scrolltext *st, int fd, unsigned int ringlines)
+{
+	struct stream *s;
+
+	if ((s = calloc(1, sizeof(struct stream))) == NULL)
+		RETURN_ERROR("Cannot allocate memory for textbox stream");
+	st->stream = s;
+	s->fd = fd;
+	s->ringlines = (ringlines == 0) ? RINGLINES : ringlines;
+	if ((s->ring = calloc(s->ringlines, sizeof(struct ringline))) == NULL)
+		RETURN_ERROR("Cannot allocate memory for textbox ring");
+	if ((s->indexbuf = calloc(SPILLINDEXBUF, sizeof(off_t))) == NULL)
+		RETURN_ERROR("Cannot allocate memory for textbox spill index");
+	if ((s->spill = tmpfile()) == NULL)
+		RETURN_ERROR("Cannot create textbox spill file");
+	if ((s->spillindex = tmpfile()) == NULL)
+		RETURN_ERROR("Cannot create textbox spill index file");
+
+	st->nlines = 0;
+	st->hpad = 1;
+
+	return (0);
+}
+
+static int stream_newline(struct scrolltext *st, off_t offset)
+{
+	struct stream *s = st->stream;
+
+	if (s->nindexbuf == SPILLINDEXBUF) {
+		if (fseeko(s->spillindex, 0, SEEK_END) != 0 ||
+		    fwrite(s->indexbuf, sizeof(off_t), SPILLINDEXBUF,
+		    s->spillindex) != SPILLINDEXBUF ||
+		    fflush(s->spillindex) != 0)
+			RETURN_ERROR("Cannot write textbox spill index");
+		s->nindexflushed += SPILLINDEXBUF;
+		s->nindexbuf = 0;
+	}
+	s->indexbuf[s->nindexbuf] = offset;
+	s->nindexbuf++;
+	s->incomplete = true;
+	st->nlines++;
+
+	return (0);
+}
+
+static int stream_append(struct scrolltext *st, const char *data, size_t size)
+{
+	size_t len, cursize;
+	char *cur;
+	const char *p, *end, *nl;
+	struct ringline *rl;
+	struct stream *s = st->stream;
+
+	if (fseeko(s->spill, 0, SEEK_END) != 0 ||
+	    fwrite(data, 1, size, s->spill) != size || fflush(s->spill) != 0)
+		RETURN_ERROR("Cannot write textbox spill file");
+
+	p = data;
+	end = data + size;
+	while (p < end) {
+		if (s->incomplete == false &&
+		    stream_newline(st, s->spillsize + (p - data)) != 0)
+			return (BSDDIALOG_ERROR);
+		nl = memchr(p, '\n', end - p);
+		len = (nl == NULL) ? (size_t)(end - p) : (size_t)(nl - p);
+		if (s->curlen + len > s->cursize) {
+			cursize = MAX(s->cursize * 2, s->curlen + len);
+			if ((cur = realloc(s->cur, cursize)) == NULL)
+				RETURN_ERROR("Cannot allocate textbox line");
+			s->cur = cur;
+			s->cursize = cursize;
+		}
+		memcpy(s->cur + s->curlen, p, len);
+		s->curlen += len;
+		if (nl == NULL)
+			break;
+
+		rl = &s->ring[s->ncomplete % s->ringlines];
+		free(rl->str);
+		if ((rl->str = malloc(MAX(s->curlen, 1))) == NULL)
+			RETURN_ERROR("Cannot allocate textbox ring line");
+		memcpy(rl->str, s->cur, s->curlen);
+		rl->len = s->curlen;
+		s->curlen = 0;
+		s->incomplete = false;
+		s->ncomplete++;
+		p = nl + 1;
+	}
+	s->spillsize += size;
+	st->hpad = MAX(st->nlines, 1);
+
+	return (0);
+}
+
+/* Returns 1 if new data or EOF, the UI is updated at most each MAXREAD. */
+static int read_stream(struct scrolltext *st)
+{
+	char buf[BUFSIZ];
+	int changed;
+	size_t total;
+	ssize_t n;
+	struct pollfd pfd;
+	struct stream *s = st->stream;
+
+	changed = 0;
+	total = 0;
+	while (s->fd >= 0 && total < STREAMMAXREAD) {
+		pfd.fd = s->fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, 0) <= 0)
+			break;
+		if ((n = read(s->fd, buf, sizeof(buf))) < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			RETURN_ERROR("Cannot read textbox file descriptor");
+		}
+		changed = 1;
+		if (n == 0) {
+			s->fd = -1; /* EOF, fd is closed by the caller */
+			break;
+		}
+		if (stream_append(st, buf, n) != 0)
+			return (BSDDIALOG_ERROR);
+		total += n;
+	}
+
+	return (changed);
+}
+
+static off_t stream_offset(struct stream *s, int line)
+{
+	off_t offset;
+
+	if (line >= s->nindexflushed)
+		return (s->indexbuf[line - s->nindexflushed]);
+
+	if (fseeko(s->spillindex, line * sizeof(off_t), SEEK_SET) != 0 ||
+	    fread(&offset, sizeof(off_t), 1, s->spillindex) != 1)
+		return (-1);
+
+	return (offset);
+}
+
+static const char *stream_getline(struct stream *s, int line, size_t *len)
+{
+	char *buf;
+	off_t start, end;
+	struct ringline *rl;
+
+	*len = 0;
+	if (s->incomplete && line == s->ncomplete) {
+		*len = s->curlen;
+		return (s->cur);
+	}
+	if (line + (int)s->ringlines >= s->ncomplete) {
+		rl = &s->ring[line % s->ringlines];
+		*len = rl->len;
+		return (rl->str);
+	}
+
+	/* old line, from the spill file */
+	start = stream_offset(s, line);
+	end = stream_offset(s, line + 1);
+	if (start < 0 || end <= start)
+		return ("");
+	*len = end - start - 1; /* newline */
+	if (*len > s->bufsize) {
+		if ((buf = realloc(s->buf, *len)) == NULL) {
+			*len = 0;
+			return ("");
+		}
+		s->buf = buf;
+		s->bufsize = *len;
+	}
+	if (fseeko(s->spill, start, SEEK_SET) != 0 ||
+	    fread(s->buf, 1, *len, s->spill) != *len) {
+		*len = 0;
+		return ("");
+	}
+
+	return (s->buf);
+}
+
+/* "offset xx xx xx xx xx xx xx xx  xx xx xx xx xx xx xx xx |ascii|" */
+static const char *hex_row(struct scrolltext *st, int line, size_t *len)
+{
+	int i, n;
+	char *p;
+	unsigned char ch;
+	size_t offset;
+	const char *hexdigits = "0123456789abcdef";
+
+	offset = (size_t)line * HEXROWBYTES;
+	n = MIN(st->size - offset, HEXROWBYTES);
+	p = st->hexrow + sprintf(st->hexrow, "%0*jx ", st->hexdigits,
+	    (uintmax_t)offset);
+	for (i = 0; i < HEXROWBYTES; i++) {
+		if (i == HEXROWBYTES / 2)
+			*p++ = ' ';
+		if (i < n) {
+			ch = st->data[offset + i];
+			*p++ = hexdigits[ch >> 4];
+			*p++ = hexdigits[ch & 0x0f];
+		} else {
+			*p++ = ' ';
+			*p++ = ' ';
+		}
+		*p++ = ' ';
+	}
+	*p++ = '|';
+	for (i = 0; i < n; i++) {
+		ch = st->data[offset + i];
+		*p++ = (ch >= 0x20 && ch < 0x7f) ? ch : '.';
+	}
+	*p++ = '|';
+	*p = '\0';
+	*len = p - st->hexrow;
+
+	return (st->hexrow);
+}
+
+static const char *getline_index(struct scrolltext *st, int line, size_t *len)
+{
+	size_t end;
+
+	if (st->stream != NULL)
+		return (stream_getline(st->stream, line, len));
+	if (st->hex)
+		return (hex_row(st, line, len));
+
+	end = (line + 1 < st->nlines) ? st->lines[line + 1] : st->size;
+	if (end > st->lines[line] && st->data[end - 1] == '\n')
+		end--;
+	*len = end - st->lines[line];
+
+	return (st->data + st->lines[line]);
+}
+
+/*
+ * Widths are computed only for printed lines, not for the whole file, and
+ * only once for each line until the text changes.
+ */
+static void measure_lines(struct scrolltext *st, int from, int n)
+{
+	int line, last, size;
+	unsigned int linecols;
+	unsigned char *measured;
+	size_t len;
+	const char *str;
+
+	last = MIN(from + n, st->nlines);
+	if (last > st->nmeasured) {
+		size = ROUNDUP8(MAX(last, st->nmeasured * 2));
+		if ((measured = realloc(st->measured, size / 8)) != NULL) {
+			memset(measured + st->nmeasured / 8, 0,
+			    (size - st->nmeasured) / 8);
+			st->measured = measured;
+			st->nmeasured = size;
+		}
+	}
+
+	for (line = from; line < last; line++) {
+		if (line < st->nmeasured) {
+			if (st->measured[line / 8] & (1 << (line % 8)))
+				continue;
+			st->measured[line / 8] |= 1 << (line % 8);
+		}
+		str = getline_index(st, line, &len);
+		if (strn_props(str, len, &linecols, NULL) != 0)
+			linecols = len; /* invalid multibyte sequence */
+		st->wpad = MAX(st->wpad, (int)linecols);
+	}
+}
+
+/*
+ * Only the columns from xpad to the width of the pad are printed, tabs are
+ * expanded here and a character across an edge is replaced by spaces.
+ * In wrap mode the line is split in rows of the width of the pad and the
+ * rows from "first" are printed at y, nrows 0 only counts the rows.
+ * Returns the number of rows of the line, valid only if nrows is 0.
+ */
+static int
+print_line(struct scrolltext *st, const char *str, size_t len, int y,
+    int first, int nrows)
+{
+	int i, col, w, left, right, row;
+	size_t charlen;
+	wchar_t wch;
+	mbstate_t mbs;
+	const char *p, *end, *match, *matchend;
+	struct search *s = &st->search;
+
+	left = st->wrap ? 0 : st->xpad;
+	right = left + getmaxx(st->pad);
+	row = 0;
+	p = str;
+	end = str + len;
+	match = matchend = str;
+	memset(&mbs, 0, sizeof(mbs));
+	for (col = 0; p < end; p += charlen) {
+		if (st->wrap == false && col >= right)
+			break;
+		if (nrows > 0 && row >= first + nrows)
+			break;
+		charlen = mbrtowc(&wch, p, end - p, &mbs);
+		if (charlen == (size_t)-1 || charlen == (size_t)-2) {
+			memset(&mbs, 0, sizeof(mbs));
+			wch = L'?';
+			charlen = 1;
+		} else if (charlen == 0) {
+			charlen = 1;
+			continue;
+		}
+		if (wch == L'\t')
+			w = st->tablen - col % st->tablen;
+		else if ((w = wchwidth(wch)) < 0)
+			continue;
+		if (st->wrap) {
+			if (col >= right ||
+			    (col + w > right && col > 0 && wch != L'\t')) {
+				row++;
+				col = 0;
+				if (wch == L'\t')
+					w = st->tablen;
+			}
+			if (wch == L'\t')
+				w = MIN(w, right - col);
+		}
+		if (nrows == 0 || row < first) {
+			col += w;
+			continue;
+		}
+		if (s->len > 0 && p >= matchend) {
+			match = memmem(p, end - p, s->pattern, s->len);
+			matchend = (match == NULL) ? end : match + s->len;
+			if (match == NULL)
+				match = end;
+		}
+
+		if (col + w > left || (w == 0 && col > left)) {
+			if (p >= match && p < matchend)
+				wattron(st->pad, A_REVERSE);
+			wmove(st->pad, y + row - first, MAX(col - left, 0));
+			if (wch == L'\t' || col < left || col + w > right) {
+				for (i = MAX(col, left); i < MIN(col + w, right);
+				    i++)
+					waddch(st->pad, ' ');
+			} else
+				waddnwstr(st->pad, &wch, 1);
+			wattroff(st->pad, A_REVERSE);
+		}
+		col += w;
+	}
+
+	return (row + 1);
+}
+
+/*
+ * Wrap mode, rows of each line for the current width are computed only when
+ * the line is reached and cached until the width changes.
+ */
+static int line_rows(struct scrolltext *st, int line)
+{
+	int n, *wraprows;
+	size_t len;
+	const char *str;
+
+	if (st->wrap == false)
+		return (1);
+
+	if (line >= st->nwraprows) {
+		n = MAX(line + 1, st->nwraprows * 2);
+		if ((wraprows = realloc(st->wraprows, n * sizeof(int))) != NULL) {
+			memset(wraprows + st->nwraprows, 0,
+			    (n - st->nwraprows) * sizeof(int));
+			st->wraprows = wraprows;
+			st->nwraprows = n;
+		}
+	}
+	if (line < st->nwraprows && st->wraprows[line] > 0)
+		return (st->wraprows[line]);
+
+	str = getline_index(st, line, &len);
+	n = print_line(st, str, len, 0, 0, 0);
+	if (line < st->nwraprows)
+		st->wraprows[line] = n;
+
+	return (n);
+}
+
+static void reset_wrap(struct scrolltext *st, int from)
+{
+	if (from < st->nwraprows)
+		memset(st->wraprows + from, 0,
+		    (st->nwraprows - from) * sizeof(int));
+}
+
+/* the lines from "from" changed, the byte of from is cleared whole */
+static void reset_measure(struct scrolltext *st, int from)
+{
+	if (from < st->nmeasured)
+		memset(st->measured + from / 8, 0,
+		    st->nmeasured / 8 - from / 8);
+}
+
+/* rows from the first visible row to the end of the text, up to max */
+static int rows_below(struct scrolltext *st, int max)
+{
+	int line, rows;
+
+	if (st->nlines == 0)
+		return (0);
+	rows = line_rows(st, st->ypad) - st->yrow;
+	for (line = st->ypad + 1; line < st->nlines && rows < max; line++)
+		rows += line_rows(st, line);
+
+	return (rows);
+}
+
+static bool at_bottom(struct scrolltext *st)
+{
+	if (st->wrap == false)
+		return (st->ypad + st->printrows >= st->hpad);
+
+	return (rows_below(st, st->printrows + 1) <= st->printrows);
+}
+
+static void scroll_up(struct scrolltext *st, int n)
+{
+	if (st->wrap == false) {
+		st->ypad = MAX(st->ypad - n, 0);
+		return;
+	}
+
+	while (n > 0) {
+		if (n <= st->yrow) {
+			st->yrow -= n;
+			break;
+		}
+		if (st->ypad == 0) {
+			st->yrow = 0;
+			break;
+		}
+		n -= st->yrow + 1;
+		st->ypad--;
+		st->yrow = line_rows(st, st->ypad) - 1;
+	}
+}
+
+static void scroll_down(struct scrolltext *st, int n)
+{
+	int rows;
+
+	if (st->wrap == false) {
+		if (st->ypad + st->printrows < st->hpad)
+			st->ypad = MIN(st->ypad + n, st->hpad - st->printrows);
+		return;
+	}
+
+	n = MIN(n, rows_below(st, n + st->printrows) - st->printrows);
+	while (n > 0) {
+		rows = line_rows(st, st->ypad) - st->yrow - 1;
+		if (n <= rows) {
+			st->yrow += n;
+			break;
+		}
+		n -= rows + 1;
+		st->ypad++;
+		st->yrow = 0;
+	}
+}
+
+static void scroll_end(struct scrolltext *st)
+{
+	if (st->wrap == false || st->nlines == 0) {
+		st->ypad = MAX(st->hpad - st->printrows, 0);
+		st->yrow = 0;
+		return;
+	}
+
+	st->ypad = st->nlines - 1;
+	st->yrow = line_rows(st, st->ypad) - 1;
+	scroll_up(st, st->printrows - 1);
+}
+
+/* "line" at the top if possible */
+static void scroll_to(struct scrolltext *st, int line)
+{
+	st->ypad = MAX(MIN(line, st->nlines - 1), 0);
+	st->yrow = 0;
+	if (at_bottom(st))
+		scroll_end(st);
+}
+
+/* line containing the byte at offset, the file has at least one line */
+static int line_at(struct scrolltext *st, size_t offset)
+{
+	int l, r, m;
+
+	l = 0;
+	r = st->nlines - 1;
+	while (l < r) {
+		m = l + (r - l + 1) / 2;
+		if (st->lines[m] <= offset)
+			l = m;
+		else
+			r = m - 1;
+	}
+
+	return (l);
+}
+
+static int add_match(struct search *s, int line)
+{
+	int maxmatches, *matches;
+
+	if (s->nmatches > 0 && s->matches[s->nmatches - 1] >= line)
+		return (0); /* already found, rescanned last line */
+	if (s->nmatches >= s->maxmatches) {
+		maxmatches = (s->maxmatches == 0) ? 1024 : s->maxmatches * 2;
+		matches = realloc(s->matches, maxmatches * sizeof(int));
+		if (matches == NULL)
+			RETURN_ERROR("Cannot allocate textbox search matches");
+		s->matches = matches;
+		s->maxmatches = maxmatches;
+	}
+	s->matches[s->nmatches] = line;
+	s->nmatches++;
+
+	return (0);
+}
+
+/*
+ * A mapped file is searched with memmem() over a chunk of contiguous lines,
+ * a match skips to the next line. A stream and the rows of the hex view are
+ * searched line by line.
+ */
+static int search_chunk(struct scrolltext *st)
+{
+	int line, endline;
+	size_t len, end;
+	const char *p, *str;
+	struct search *s = &st->search;
+
+	if (s->scanned >= st->nlines)
+		return (0);
+
+	if (st->stream != NULL || st->hex) {
+		endline = MIN(s->scanned + SEARCHLINES, st->nlines);
+		for (line = s->scanned; line < endline; line++) {
+			str = getline_index(st, line, &len);
+			if (memmem(str, len, s->pattern, s->len) == NULL)
+				continue;
+			if (add_match(s, line) != 0)
+				return (BSDDIALOG_ERROR);
+		}
+		s->scanned = endline;
+		return (0);
+	}
+
+	endline = line_at(st, st->lines[s->scanned] + SEARCHCHUNK) + 1;
+	end = (endline < st->nlines) ? st->lines[endline] : st->size;
+	p = st->data + st->lines[s->scanned];
+	while ((p = memmem(p, end - (p - st->data), s->pattern, s->len)) !=
+	    NULL) {
+		line = line_at(st, p - st->data);
+		if (add_match(s, line) != 0)
+			return (BSDDIALOG_ERROR);
+		if (line + 1 >= endline)
+			break;
+		p = st->data + st->lines[line + 1];
+	}
+	s->scanned = endline;
+
+	return (0);
+}
+
+/* first match after "from" or last match before "from", 1 if not found */
+static int search_find(struct scrolltext *st, int from, bool forward, int *line)
+{
+	int l, r, m;
+	struct search *s = &st->search;
+
+	for (;;) {
+		/* first index with a match > from */
+		l = 0;
+		r = s->nmatches;
+		while (l < r) {
+			m = l + (r - l) / 2;
+			if (s->matches[m] <= from)
+				l = m + 1;
+			else
+				r = m;
+		}
+		if (forward && l < s->nmatches) {
+			*line = s->matches[l];
+			return (0);
+		}
+		if (forward == false && s->scanned >= from) {
+			if (l > 0 && s->matches[l - 1] == from)
+				l--;
+			if (l == 0)
+				return (1);
+			*line = s->matches[l - 1];
+			return (0);
+		}
+		if (s->scanned >= st->nlines)
+			return (1);
+		if (search_chunk(st) != 0)
+			return (BSDDIALOG_ERROR);
+	}
+}
+
+/* a new search starts from the first visible line, next from the last match */
+static int search_jump(struct scrolltext *st, bool forward, bool newsearch)
+{
+	int from, line, rv;
+	struct search *s = &st->search;
+
+	if (s->len == 0)
+		return (0);
+	if (newsearch)
+		from = forward ? st->ypad - 1 : st->ypad;
+	else
+		from = (st->ypad == s->ypad) ? s->cur : st->ypad;
+
+	if ((rv = search_find(st, from, forward, &line)) < 0)
+		return (BSDDIALOG_ERROR);
+	s->notfound = (rv == 1);
+	if (s->notfound)
+		return (0);
+	s->cur = line;
+	scroll_to(st, line);
+	s->ypad = st->ypad;
+
+	return (0);
+}
+
+static void print_lines(struct dialog *d, struct scrolltext *st)
+{
+	int y, line, first, nrows;
+	unsigned int defaulttablen;
+	size_t len;
+	const char *str;
+
+	defaulttablen = TABSIZE;
+	if (d->conf->text.tablen > 0)
+		set_tabsize(d->conf->text.tablen);
+
+	measure_lines(st, st->ypad, st->printrows);
+	werase(st->pad);
+	y = 0;
+	first = st->yrow;
+	for (line = st->ypad; y < st->printrows && line < st->nlines; line++) {
+		nrows = MIN(line_rows(st, line) - first, st->printrows - y);
+		str = getline_index(st, line, &len);
+		print_line(st, str, len, y, first, nrows);
+		y += nrows;
+		first = 0;
+	}
+	st->lastline = line - 1;
+
+	set_tabsize(defaulttablen); /* reset because it is curses global */
+}
+
 static void updateborders(struct dialog *d, struct scrolltext *st)
 {
+	char status[SEARCHMAX + 32];
 	chtype arrowch;
-	cchar_t borderch;
+	cchar_t borderch, sepch;
+	struct search *s = &st->search;
 
 	if (d->conf->no_lines)
 		setcchar(&borderch, L" ", 0, 0, NULL);
@@ -66,7 +1225,7 @@ static void updateborders(struct dialog *d, struct scrolltext *st)
 		wattroff(d->widget, t.dialog.lineraisecolor);
 	}
 
-	if (st->xpad + d->w - 2 - st->margin < st->wpad) {
+	if (st->wrap == false && st->xpad + d->w - 2 < st->wpad) {
 		arrowch = RARROW(d->conf) | t.dialog.arrowcolor;
 		mvwvline(d->widget, (d->h / 2) - 2, d->w - 1, arrowch, 4);
 	} else {
@@ -75,12 +1234,155 @@ static void updateborders(struct dialog *d, struct scrolltext *st)
 		wattroff(d->widget, t.dialog.linelowercolor);
 	}
 
-	if (st->hpad > d->h - 4) {
+	/* separator, it could be covered by the search prompt */
+	if (d->conf->no_lines)
+		setcchar(&sepch, L" ", 0, 0, NULL);
+	else if (d->conf->ascii_lines)
+		setcchar(&sepch, L"-", 0, 0, NULL);
+	else
+		sepch = *WACS_HLINE;
+	wattron(d->widget, t.dialog.lineraisecolor);
+	mvwhline_set(d->widget, d->h - 3, 1, &sepch, d->w - 2);
+	wattroff(d->widget, t.dialog.lineraisecolor);
+
+	if (s->len > 0) {
+		if (s->notfound)
+			snprintf(status, sizeof(status), "[%s: not found]",
+			    s->pattern);
+		else
+			snprintf(status, sizeof(status), "[%s: %d%s]",
+			    s->pattern, s->nmatches, SEARCHING(st) ? "+" : "");
+		wattron(d->widget, t.dialog.arrowcolor);
+		mvwaddnstr(d->widget, d->h - 3, 1, status, d->w - 8);
+		wattroff(d->widget, t.dialog.arrowcolor);
+	}
+
+	if (st->wrap && (st->ypad > 0 || st->yrow > 0 || !at_bottom(st))) {
 		wattron(d->widget, t.dialog.arrowcolor);
 		mvwprintw(d->widget, d->h - 3, d->w - 6,
-		    "%3d%%", 100 * (st->ypad + d->h - 4) / st->hpad);
+		    "%3d%%", (int)(100LL * (st->lastline + 1) / st->hpad));
 		wattroff(d->widget, t.dialog.arrowcolor);
+	} else if (st->wrap == false && st->hpad > d->h - 4) {
+		wattron(d->widget, t.dialog.arrowcolor);
+		mvwprintw(d->widget, d->h - 3, d->w - 6,
+		    "%3d%%", (int)(100LL * (st->ypad + d->h - 4) / st->hpad));
+		wattroff(d->widget, t.dialog.arrowcolor);
+	}
+}
+
+static void set_timeout(struct scrolltext *st)
+{
+	if (SEARCHING(st))
+		timeout(0);
+	else if (st->stream != NULL && st->stream->fd >= 0)
+		timeout(STREAMTIMEOUT);
+	else if (st->fd >= 0)
+		timeout(FOLLOWTIMEOUT);
+	else
+		timeout(-1);
+}
+
+/* edit a string on the separator, 1 if canceled */
+static int
+prompt(struct dialog *d, struct scrolltext *st, char prefix, char *buf)
+{
+	bool loop;
+	int n, cols, rv;
+	wint_t input;
+	wchar_t wbuf[SEARCHMAX];
+
+	n = 0;
+	wbuf[0] = L'\0';
+	cols = d->w - 4;
+	curs_set(1);
+	timeout(-1); /* no follow, stream or search while typing */
+	loop = true;
+	while (loop) {
+		wattron(d->widget, t.dialog.color);
+		mvwhline(d->widget, d->h - 3, 1, ' ', d->w - 2);
+		mvwaddch(d->widget, d->h - 3, 1, prefix);
+		waddwstr(d->widget, wbuf + MAX(n - cols, 0));
+		wattroff(d->widget, t.dialog.color);
+		wrefresh(d->widget);
+		if ((rv = get_wch(&input)) == ERR)
+			continue;
+		if (rv == KEY_CODE_YES) {
+			if (input == KEY_ENTER)
+				input = 10;
+			else if (input == KEY_BACKSPACE)
+				input = 127;
+			else
+				continue;
+		}
+		switch (input) {
+		case 10: /* Enter */
+			loop = false;
+			break;
+		case 27: /* Esc */
+			curs_set(0);
+			set_timeout(st);
+			return (1);
+		case 8:
+		case 127: /* Backspace */
+			if (n > 0)
+				wbuf[--n] = L'\0';
+			break;
+		default:
+			if (iswprint(input) == 0 || n >= SEARCHMAX - 1)
+				break;
+			wbuf[n] = input;
+			wbuf[n + 1] = L'\0';
+			if (wcstombs(buf, wbuf, SEARCHMAX) >= SEARCHMAX - 1) {
+				wbuf[n] = L'\0';
+				break;
+			}
+			n++;
+		}
+	}
+	curs_set(0);
+	set_timeout(st);
+	if (wcstombs(buf, wbuf, SEARCHMAX) == (size_t)-1)
+		buf[0] = '\0';
+
+	return (0);
+}
+
+static int search_prompt(struct dialog *d, struct scrolltext *st, bool forward)
+{
+	char pattern[SEARCHMAX];
+	struct search *s = &st->search;
+
+	if (prompt(d, st, forward ? '/' : '?', pattern) != 0)
+		return (1);
+	if (pattern[0] != '\0') { /* empty pattern, previous search */
+		strcpy(s->pattern, pattern);
+		s->len = strlen(s->pattern);
+		s->nmatches = 0;
+		s->scanned = 0;
 	}
+	s->forward = forward;
+
+	return (s->len > 0 ? 0 : 1);
+}
+
+/* ":N" first visible line N, ":N%" N percent of the lines */
+static void goto_prompt(struct dialog *d, struct scrolltext *st)
+{
+	char buf[SEARCHMAX], *end;
+	long n;
+
+	if (prompt(d, st, ':', buf) != 0)
+		return;
+	n = strtol(buf, &end, 10);
+	if (end == buf || n < 0)
+		return;
+	if (*end == '%' && end[1] == '\0')
+		n = (long)st->nlines * MIN(n, 100) / 100;
+	else if (*end == '\0')
+		n = MAX(n - 1, 0);
+	else
+		return;
+	scroll_to(st, MIN(n, INT_MAX));
 }
 
 static int textbox_size_position(struct dialog *d, struct scrolltext *st)
@@ -89,10 +1391,9 @@ static int textbox_size_position(struct dialog *d, struct scrolltext *st)
 
 	if (set_widget_size(d->conf, d->rows, d->cols, &d->h, &d->w) != 0)
 		return (BSDDIALOG_ERROR);
-	if (set_widget_autosize(d->conf, d->rows, d->cols, &d->h, &d->w,
-	    d->text, NULL, &d->bs, st->hpad, st->wpad + st->margin) != 0)
+	if (set_widget_autosize(d, NULL, st->hpad, st->wpad) != 0)
 		return (BSDDIALOG_ERROR);
-	minw = (st->wpad > 0) ? 2 /*multicolumn char*/ + st->margin : 0 ;
+	minw = (st->wpad > 0) ? 2 /*multicolumn char*/ : 0 ;
 	if (widget_checksize(d->h, d->w, &d->bs, MIN(st->hpad, 1), minw) != 0)
 		return (BSDDIALOG_ERROR);
 	if (set_widget_position(d->conf, &d->y, &d->x, d->h, d->w) != 0)
@@ -115,82 +1416,168 @@ static int textbox_draw(struct dialog *d, struct scrolltext *st)
 		refresh(); /* Important to fix grey lines expanding screen */
 
 	st->ys = d->y + 1;
-	st->xs = (st->margin == 0) ? d->x + 1 : d->x + 2;
+	st->xs = d->x + 1;
 	st->ye = st->ys + d->h - 5;
-	st->xe = st->xs + d->w - 3 - st->margin;
-	st->ypad = st->xpad = 0;
+	st->xe = st->xs + d->w - 3;
+	st->ypad = st->yrow = st->xpad = 0;
 	st->printrows = d->h-4;
+	wresize(st->pad, MAX(st->printrows, 1), MAX(d->w - 2, 1));
+	if (st->wrap && st->wrapwidth != getmaxx(st->pad)) {
+		st->wrapwidth = getmaxx(st->pad);
+		reset_wrap(st, 0);
+	}
 
 	return (0);
 }
 
-/* API */
-int
-bsddialog_textbox(struct bsddialog_conf *conf, const char *file, int rows,
+/* autosizing while a followed file or a stream grows */
+static int textbox_grow(struct dialog *d, struct scrolltext *st)
+{
+	int h, w, y, x, ypad, yrow, xpad;
+
+	if (d->rows != BSDDIALOG_AUTOSIZE && d->cols != BSDDIALOG_AUTOSIZE)
+		return (0);
+	h = d->h;
+	w = d->w;
+	y = d->y;
+	x = d->x;
+	if (textbox_size_position(d, st) != 0)
+		return (BSDDIALOG_ERROR);
+	if (d->h == h && d->w == w)
+		return (0);
+
+	/* old geometry to hide the dialog */
+	d->h = h;
+	d->w = w;
+	d->y = y;
+	d->x = x;
+	ypad = st->ypad;
+	yrow = st->yrow;
+	xpad = st->xpad;
+	if (textbox_draw(d, st) != 0)
+		return (BSDDIALOG_ERROR);
+	st->ypad = ypad;
+	st->yrow = (st->wrap && yrow < line_rows(st, ypad)) ? yrow : 0;
+	st->xpad = xpad;
+
+	return (0);
+}
+
+static int update_text(struct dialog *d, struct scrolltext *st)
+{
+	bool bottom;
+	int changed, lastline;
+
+	bottom = at_bottom(st);
+	lastline = st->nlines - 1; /* could be incomplete */
+	if (st->stream != NULL)
+		changed = read_stream(st);
+	else
+		changed = follow_file(st);
+	if (changed < 0)
+		return (BSDDIALOG_ERROR);
+
+	if (changed == 2) {
+		st->search.nmatches = 0;
+		st->search.scanned = 0;
+		reset_wrap(st, 0);
+		reset_measure(st, 0);
+		if (textbox_draw(d, st) != 0)
+			return (BSDDIALOG_ERROR);
+	}
+	if (changed == 1) {
+		st->search.scanned = MIN(st->search.scanned, MAX(lastline, 0));
+		reset_wrap(st, MAX(lastline, 0));
+		reset_measure(st, MAX(lastline, 0));
+		if (textbox_grow(d, st) != 0)
+			return (BSDDIALOG_ERROR);
+		if (bottom)
+			scroll_end(st);
+	}
+
+	return (0);
+}
+
+static int
+do_textbox(struct bsddialog_conf *conf, const char *file, int fd, int rows,
     int cols)
 {
-	bool loop, has_multicol_ch;
-	int i, retval;
-	unsigned int defaulttablen, linecols;
+	bool loop;
+	int retval;
+	unsigned int defaulttablen;
 	wint_t input;
-	char buf[BUFSIZ];
-	FILE *fp;
 	struct scrolltext st;
 	struct dialog d;
 
-	if (file == NULL)
-		RETURN_ERROR("*file is NULL");
-	if ((fp = fopen(file, "r")) == NULL)
-		RETURN_FMTERROR("Cannot open file \"%s\"", file);
+	st.fd = -1;
+	st.nlines = st.maxlines = 0;
+	st.lines = NULL;
+	st.cachemap = NULL;
+	st.stream = NULL;
+	memset(&st.search, 0, sizeof(st.search));
+	st.tablen = (conf->text.tablen > 0) ? (int)conf->text.tablen : TABSIZE;
+	st.hex = conf->textbox.hex && file != NULL;
+	st.wrap = conf->textbox.wrap && !st.hex;
+	st.wrapwidth = 0;
+	st.wraprows = NULL;
+	st.nwraprows = 0;
+	st.measured = NULL;
+	st.nmeasured = 0;
+	st.ypad = st.yrow = 0;
+	st.data = NULL;
+	st.size = 0;
+	st.mapped = false;
+	/* an error goes to close before the dialog, to end after */
+	retval = BSDDIALOG_ERROR;
+	if (file != NULL) {
+		if (read_file(&st, file, conf->textbox.follow) != 0)
+			goto close;
+		if (index_file(&st, conf->textbox.cachedir, file) != 0)
+			goto close;
+	} else {
+		if (open_stream(&st, fd, conf->textbox.ringlines) != 0)
+			goto close;
+		if (read_stream(&st) < 0)
+			goto close;
+	}
 
 	if (prepare_dialog(conf, "" /* fake */, rows, cols, &d) != 0)
-		return (BSDDIALOG_ERROR);
+		goto close;
 	set_buttons(&d, true, "EXIT", NULL);
+	st.pad = NULL;
 
 	defaulttablen = TABSIZE;
 	if (conf->text.tablen > 0)
 		set_tabsize(conf->text.tablen);
-	st.hpad = 1;
 	st.wpad = 1;
-	st.pad = newpad(st.hpad, st.wpad);
-	wbkgd(st.pad, t.dialog.color);
-	st.margin = 0;
-	i = 0;
-	while (fgets(buf, BUFSIZ, fp) != NULL) {
-		if (str_props(buf, &linecols, &has_multicol_ch) != 0)
-			continue;
-		if ((int)linecols > st.wpad) {
-			st.wpad = linecols;
-			wresize(st.pad, st.hpad, st.wpad);
-		}
-		if (i > st.hpad-1) {
-			st.hpad++;
-			wresize(st.pad, st.hpad, st.wpad);
-		}
-		mvwaddstr(st.pad, i, 0, buf);
-		i++;
-		if (has_multicol_ch)
-			st.margin = 2;
-	}
-	fclose(fp);
+	measure_lines(&st, 0, SCREENLINES); /* for autosizing */
 	set_tabsize(defaulttablen); /* reset because it is curses global */
-
+	if ((st.pad = newpad(1, st.wpad)) == NULL) {
+		set_error_string("Cannot build the pad WINDOW for textbox");
+		goto end;
+	}
+	wbkgd(st.pad, t.dialog.color);
 	if (textbox_draw(&d, &st) != 0)
-		return (BSDDIALOG_ERROR);
+		goto end;
 
 	loop = true;
 	while (loop) {
+		set_timeout(&st);
+		print_lines(&d, &st);
 		updateborders(&d, &st);
-		/*
-		 * Trick, overflow multicolumn charchter right border:
-		 * wnoutrefresh(widget);
-		 * pnoutrefresh(pad, ypad, xpad, ys, xs, ye, xe);
-		 * doupdate();
-		 */
 		wrefresh(d.widget);
-		prefresh(st.pad, st.ypad, st.xpad, st.ys, st.xs, st.ye, st.xe);
-		if (get_wch(&input) == ERR)
+		prefresh(st.pad, 0, 0, st.ys, st.xs, st.ye, st.xe);
+		if (get_wch(&input) == ERR) { /* timeout */
+			if (update_text(&d, &st) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
+			if (SEARCHING(&st) && search_chunk(&st) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			continue;
+		}
 		if (shortcut_buttons(input, &d.bs)) {
 			DRAW_BUTTONS(d);
 			doupdate();
@@ -214,18 +1601,21 @@ bsddialog_textbox(struct bsddialog_conf *conf, const char *file, int rows,
 			DRAW_BUTTONS(d);
 			break;
 		case KEY_HOME:
-			st.ypad = 0;
+		case 'g':
+			st.ypad = st.yrow = 0;
 			break;
 		case KEY_END:
-			st.ypad = MAX(st.hpad - st.printrows, 0);
+		case 'G':
+			scroll_end(&st);
+			break;
+		case ':':
+			goto_prompt(&d, &st);
 			break;
 		case KEY_PPAGE:
-			st.ypad = MAX(st.ypad - st.printrows, 0);
+			scroll_up(&st, st.printrows);
 			break;
 		case KEY_NPAGE:
-			st.ypad += st.printrows;
-			if (st.ypad + st.printrows > st.hpad)
-				st.ypad = st.hpad - st.printrows;
+			scroll_down(&st, st.printrows);
 			break;
 		case '0':
 			st.xpad = 0;
@@ -236,37 +1626,87 @@ bsddialog_textbox(struct bsddialog_conf *conf, const char *file, int rows,
 			break;
 		case KEY_RIGHT:
 		case 'l':
-			if (st.xpad + d.w - 2 - st.margin < st.wpad)
+			if (st.wrap == false && st.xpad + d.w - 2 < st.wpad)
 				st.xpad++;
 			break;
 		case KEY_UP:
 		case 'k':
-			st.ypad = MAX(st.ypad - 1, 0);
+			scroll_up(&st, 1);
 			break;
 		case KEY_DOWN:
 		case'j':
-			if (st.ypad + st.printrows <= st.hpad -1)
-				st.ypad++;
+			scroll_down(&st, 1);
+			break;
+		case '/':
+		case '?':
+			if (search_prompt(&d, &st, input == '/') != 0)
+				break;
+			if (search_jump(&st, st.search.forward, true) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
+			break;
+		case 'n':
+		case 'N':
+			if (search_jump(&st, (input == 'n') == st.search.forward,
+			    false) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		case KEY_F(1):
 			if (conf->key.f1_file == NULL &&
 			    conf->key.f1_message == NULL)
 				break;
-			if (f1help_dialog(conf) != 0)
-				return (BSDDIALOG_ERROR);
-			if (textbox_draw(&d, &st) != 0)
-				return (BSDDIALOG_ERROR);
+			/* the help waits for a key, the loop sets it again */
+			timeout(-1);
+			if (f1help_dialog(conf) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
+			if (textbox_draw(&d, &st) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		case KEY_CTRL('l'):
 		case KEY_RESIZE:
-			if (textbox_draw(&d, &st) != 0)
-				return (BSDDIALOG_ERROR);
+			if (textbox_draw(&d, &st) != 0) {
+				retval = BSDDIALOG_ERROR;
+				goto end;
+			}
 			break;
 		}
 	}
 
+end:
+	timeout(-1);
 	delwin(st.pad);
 	end_dialog(&d);
+close:
+	close_file(&st);
+	free(st.search.matches);
+	free(st.wraprows);
+	free(st.measured);
 
 	return (retval);
 }
+
+/* API */
+int
+bsddialog_textbox(struct bsddialog_conf *conf, const char *file, int rows,
+    int cols)
+{
+	CHECK_PTR(file);
+
+	return (do_textbox(conf, file, -1, rows, cols));
+}
+
+int
+bsddialog_textbox_fd(struct bsddialog_conf *conf, int fd, int rows, int cols)
+{
+	if (fd < 0)
+		RETURN_FMTERROR("Bad file descriptor: %d", fd);
+
+	return (do_textbox(conf, NULL, fd, rows, cols));
+}
@@ -204,7 +204,8 @@ int main(int argc, char *argv[argc])
 				    "expected <text> <rows> <cols>");
 			if ((text = strdup(argv[0])) == NULL)
 				exit_error(false, "cannot allocate <text>");
-			if (opt.dialogbuilder != textbox_builder)
+			if (opt.dialogbuilder != textbox_builder &&
+			    opt.dialogbuilder != tailbox_builder)
 				custom_text(&opt, argv[0], text);
 			rows = (int)strtol(argv[1], NULL, 10);
 			cols = (int)strtol(argv[2], NULL, 10);
@@ -49,6 +49,7 @@ struct options {
 	bool item_output_sepnl;
 	bool item_prefix;
 	bool item_singlequote;
+	char *menu_from;
 	/* Menus and Forms options */
 	bool help_print_item_name;
 	bool help_print_items;
@@ -108,6 +109,7 @@ int passwordform_builder(BUILDER_ARGS);
 int pause_builder(BUILDER_ARGS);
 int radiolist_builder(BUILDER_ARGS);
 int rangebox_builder(BUILDER_ARGS);
+int tailbox_builder(BUILDER_ARGS);
 int textbox_builder(BUILDER_ARGS);
 int timebox_builder(BUILDER_ARGS);
 int treeview_builder(BUILDER_ARGS);
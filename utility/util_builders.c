@@ -25,6 +25,7 @@
  * SUCH DAMAGE.
  */
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -66,11 +67,24 @@ int yesno_builder(BUILDER_ARGS)
 }
 
 /* textbox */
+int tailbox_builder(BUILDER_ARGS)
+{
+	if (argc > 0)
+		error_args(opt->name, argc, argv);
+
+	conf->textbox.follow = true;
+
+	return (bsddialog_textbox(conf, text, rows, cols));
+}
+
 int textbox_builder(BUILDER_ARGS)
 {
 	if (argc > 0)
 		error_args(opt->name, argc, argv);
 
+	if (strcmp(text, "-") == 0)
+		return (bsddialog_textbox_fd(conf, STDIN_FILENO, rows, cols));
+
 	return (bsddialog_textbox(conf, text, rows, cols));
 }
 
@@ -453,6 +467,40 @@ int checklist_builder(BUILDER_ARGS)
 	return (output);
 }
 
+/* an item for each line of the file, "-" is stdin */
+static int
+menu_from_builder(struct bsddialog_conf *conf, char* text, int rows, int cols,
+    unsigned int menurows, struct options *opt)
+{
+	int fd, output, focusitem;
+	char *name;
+	struct bsddialog_menuitem item;
+
+	if (strcmp(opt->menu_from, "-") == 0)
+		fd = STDIN_FILENO;
+	else if ((fd = open(opt->menu_from, O_RDONLY)) < 0)
+		exit_error(false, "--menu-from cannot open %s", opt->menu_from);
+
+	focusitem = -1;
+	output = bsddialog_menu_fd(conf, text, rows, cols, menurows, fd,
+	    &focusitem, &name);
+	if (fd != STDIN_FILENO)
+		close(fd);
+
+	if (name != NULL) {
+		item.prefix = "";
+		item.on = true;
+		item.depth = 0;
+		item.name = name;
+		item.desc = "";
+		item.bottomdesc = "";
+		print_menu_items(output, 1, &item, 0, opt);
+	}
+	free(name);
+
+	return (output);
+}
+
 int menu_builder(BUILDER_ARGS)
 {
 	int output, focusitem;
@@ -463,6 +511,13 @@ int menu_builder(BUILDER_ARGS)
 		exit_error(true, "--menu missing <menurows>");
 	menurows = (unsigned int)strtoul(argv[0], NULL, 10);
 
+	if (opt->menu_from != NULL) {
+		if (argc > 1)
+			error_args(opt->name, argc - 1, argv + 1);
+		return (menu_from_builder(conf, text, rows, cols, menurows,
+		    opt));
+	}
+
 	get_menu_items(argc-1, argv+1, opt->item_prefix, opt->item_depth, true,
 	    true, false, opt->item_bottomdesc, &nitems, &items, &focusitem,
 	    opt);
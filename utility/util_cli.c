@@ -86,6 +86,7 @@ enum OPTS {
 	LEFT3_EXIT_CODE,
 	LOAD_THEME,
 	MAX_INPUT_FORM,
+	MENU_FROM,
 	NO_CANCEL,
 	NO_DESCRIPTIONS,
 	NO_LINES,
@@ -119,6 +120,9 @@ enum OPTS {
 	TAB_LEN,
 	TEXT_ESCAPE,
 	TEXT_UNCHANGED,
+	TEXTBOX_CACHE,
+	TEXTBOX_HEX,
+	TEXTBOX_WRAP,
 	THEME,
 	TIMEOUT_EXIT_CODE,
 	TIME_FORMAT,
@@ -140,6 +144,7 @@ enum OPTS {
 	PAUSE,
 	RADIOLIST,
 	RANGEBOX,
+	TAILBOX,
 	TEXTBOX,
 	TIMEBOX,
 	TREEVIEW,
@@ -203,6 +208,7 @@ static struct option longopts[] = {
 	{"left3-exit-code",   required_argument, NULL, LEFT3_EXIT_CODE},
 	{"load-theme",        required_argument, NULL, LOAD_THEME},
 	{"max-input",         required_argument, NULL, MAX_INPUT_FORM},
+	{"menu-from",         required_argument, NULL, MENU_FROM},
 	{"no-cancel",         no_argument,       NULL, NO_CANCEL},
 	{"nocancel",          no_argument,       NULL, NO_CANCEL},
 	{"no-descriptions",   no_argument,       NULL, NO_DESCRIPTIONS},
@@ -242,6 +248,9 @@ static struct option longopts[] = {
 	{"tab-len",           required_argument, NULL, TAB_LEN},
 	{"text-escape",       no_argument,       NULL, TEXT_ESCAPE},
 	{"text-unchanged",    no_argument,       NULL, TEXT_UNCHANGED},
+	{"textbox-cache",     required_argument, NULL, TEXTBOX_CACHE},
+	{"textbox-hex",       no_argument,       NULL, TEXTBOX_HEX},
+	{"textbox-wrap",      no_argument,       NULL, TEXTBOX_WRAP},
 	{"theme",             required_argument, NULL, THEME},
 	{"timeout-exit-code", required_argument, NULL, TIMEOUT_EXIT_CODE},
 	{"time-format",       required_argument, NULL, TIME_FORMAT},
@@ -264,6 +273,7 @@ static struct option longopts[] = {
 	{"pause",        no_argument, NULL, PAUSE},
 	{"radiolist",    no_argument, NULL, RADIOLIST},
 	{"rangebox",     no_argument, NULL, RANGEBOX},
+	{"tailbox",      no_argument, NULL, TAILBOX},
 	{"textbox",      no_argument, NULL, TEXTBOX},
 	{"timebox",      no_argument, NULL, TIMEBOX},
 	{"treeview",     no_argument, NULL, TREEVIEW},
@@ -299,9 +309,10 @@ void usage(void)
 	    " --help-print-items, --help-print-name, --hfile <file>,"
 	    " --hline <string>,\n --hmsg <string>, --ignore, --insecure,"
 	    " --item-bottom-desc, --item-depth,\n --item-prefix,"
-	    " --load-theme <file>, --max-input <size>, --no-cancel,\n"
-	    " --no-descriptions, --no-label <label>, --no-lines, --no-names,"
-	    " --no-ok,\n --no-shadow, --normal-screen, --ok-exit-code <retval>,"
+	    " --load-theme <file>, --max-input <size>,\n"
+	    " --menu-from <file>, --no-cancel, --no-descriptions,"
+	    " --no-label <label>,\n --no-lines, --no-names, --no-ok, --no-shadow,"
+	    " --normal-screen,\n --ok-exit-code <retval>,"
 	    " --ok-label <label>,\n --output-fd <fd>, --output-separator <sep>,"
 	    " --print-maxsize, --print-size,\n --print-version, --quoted,"
 	    " --right1-button <label>,\n --right1-exit-code <retval>,"
@@ -310,7 +321,8 @@ void usage(void)
 	    " --save-theme <file>, --separate-output,\n --separator <sep>,"
 	    " --shadow, --single-quoted, --sleep <secs>, --stderr,\n --stdout,"
 	    " --switch-buttons, --tab-escape, --tab-len <spaces>,"
-	    " --text-escape,\n --text-unchanged, --theme 3d|blackwhite|flat,"
+	    " --text-escape,\n --text-unchanged, --textbox-cache <dir>,"
+	    " --textbox-hex,\n --textbox-wrap, --theme 3d|blackwhite|flat,"
 	    " --timeout-exit-code <retval>,\n --time-format <format>,"
 	    " --title <title>, --yes-label <label>.");
 	printf("\n\n");
@@ -341,6 +353,7 @@ void usage(void)
 	printf(" --radiolist <text> <rows> <cols> <menurows> [<name> <desc> "
 	    "on|off] ...\n");
 	printf(" --rangebox <text> <rows> <cols> <min> <max> [<init>]\n");
+	printf(" --tailbox <file> <rows> <cols>\n");
 	printf(" --textbox <file> <rows> <cols>\n");
 	printf(" --timebox <text> <rows> <cols> [<hh> <mm> <ss>]\n");
 	printf(" --treeview <text> <rows> <cols> <menurows> [<depth> <name> "
@@ -549,6 +562,9 @@ parseargs(int argc, char **argv, struct bsddialog_conf *conf,
 		case MAX_INPUT_FORM:
 			opt->max_input_form = (u_int)strtoul(optarg, NULL, 10);
 			break;
+		case MENU_FROM:
+			opt->menu_from = optarg;
+			break;
 		case NO_CANCEL:
 			conf->button.without_cancel = true;
 			break;
@@ -659,6 +675,15 @@ parseargs(int argc, char **argv, struct bsddialog_conf *conf,
 		case TEXT_UNCHANGED:
 			opt->text_unchanged = true;
 			break;
+		case TEXTBOX_CACHE:
+			conf->textbox.cachedir = optarg;
+			break;
+		case TEXTBOX_HEX:
+			conf->textbox.hex = true;
+			break;
+		case TEXTBOX_WRAP:
+			conf->textbox.wrap = true;
+			break;
 		case THEME:
 			if (strcasecmp(optarg, "blackwhite") == 0)
 				opt->theme = BSDDIALOG_THEME_BLACKWHITE;
@@ -801,6 +826,13 @@ parseargs(int argc, char **argv, struct bsddialog_conf *conf,
 			opt->name = "--rangebox";
 			opt->dialogbuilder = rangebox_builder;
 			break;
+		case TAILBOX:
+			if (opt->dialogbuilder != NULL)
+				exit_error(true, "%s and --tailbox without "
+				    "--and-dialog", opt->name);
+			opt->name = "--tailbox";
+			opt->dialogbuilder = tailbox_builder;
+			break;
 		case TEXTBOX:
 			if (opt->dialogbuilder != NULL)
 				exit_error(true, "%s and --textbox without "